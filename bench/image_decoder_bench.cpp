@@ -0,0 +1,391 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Times the software image decoders, and the cairo surface conversions,
+// over a corpus generated in memory: PNG of every color type, interlaced
+// or not, baseline JPEG at full and reduced scale, GIF and its
+// interlaced variant, at sizes from icons to full HD. Nothing is drawn,
+// so it runs without a display or GL context.
+//
+// MB/s are megabytes of RGBA produced per second, so formats and sizes
+// compare with each other.
+
+#include <ghtv/opengl/linux/load_png.hpp>
+#include <ghtv/opengl/linux/load_jpg.hpp>
+#include <ghtv/opengl/linux/load_gif.hpp>
+#include <ghtv/opengl/linux/image_conversion.hpp>
+#include <ghtv/opengl/linux/clock.hpp>
+
+#include <png.h>
+#include <jpeglib.h>
+#include <gif_lib.h>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+namespace linux_ = ghtv::opengl::linux_;
+
+namespace {
+
+// Each case runs at least this long, and this many times
+boost::int64_t const min_microseconds = 300000;
+int const min_runs = 3;
+// Same as the image cache, so frames are composed ahead
+std::size_t const gif_composed_budget = 8u << 20;
+
+typedef std::vector<unsigned char> bytes;
+
+// Gradients with some noise, compressed about as well as photos and
+// artwork of TV applications
+unsigned char sample(std::size_t x, std::size_t y, std::size_t channel)
+{
+  return (x * (channel + 1) + y * (3 - channel) + (std::rand() & 15)) & 0xFF;
+}
+
+// PNG
+
+void write_png_bytes(png_structp png, png_bytep data, png_size_t size)
+{
+  bytes& out = *static_cast<bytes*>(png_get_io_ptr(png));
+  out.insert(out.end(), data, data + size);
+}
+
+void flush_png(png_structp)
+{
+}
+
+bytes make_png(std::size_t width, std::size_t height, int color_type, bool interlaced)
+{
+  std::size_t channels = 1;
+  if(color_type == PNG_COLOR_TYPE_RGB)
+    channels = 3;
+  else if(color_type == PNG_COLOR_TYPE_RGB_ALPHA)
+    channels = 4;
+
+  bytes pixels(width * height * channels);
+  for(std::size_t y = 0; y != height; ++y)
+    for(std::size_t x = 0; x != width; ++x)
+      for(std::size_t c = 0; c != channels; ++c)
+        pixels[(y * width + x) * channels + c] = sample(x, y, c);
+
+  bytes out;
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+  png_infop info = png_create_info_struct(png);
+  png_set_write_fn(png, &out, &write_png_bytes, &flush_png);
+  png_set_IHDR(png, info, width, height, 8, color_type
+               , interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE
+               , PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  if(color_type == PNG_COLOR_TYPE_PALETTE)
+  {
+    png_color palette[256];
+    for(int i = 0; i != 256; ++i)
+    {
+      palette[i].red = i;
+      palette[i].green = 255 - i;
+      palette[i].blue = (i * 7) & 0xFF;
+    }
+    png_set_PLTE(png, info, palette, 256);
+  }
+  std::vector<png_bytep> rows(height);
+  for(std::size_t y = 0; y != height; ++y)
+    rows[y] = &pixels[y * width * channels];
+  png_set_rows(png, info, &rows[0]);
+  png_write_png(png, info, PNG_TRANSFORM_IDENTITY, 0);
+  png_destroy_write_struct(&png, &info);
+  return out;
+}
+
+// JPEG
+
+bytes make_jpg(std::size_t width, std::size_t height, int quality)
+{
+  bytes pixels(width * height * 3);
+  for(std::size_t y = 0; y != height; ++y)
+    for(std::size_t x = 0; x != width; ++x)
+      for(std::size_t c = 0; c != 3; ++c)
+        pixels[(y * width + x) * 3 + c] = sample(x, y, c);
+
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  unsigned char* buffer = 0;
+  unsigned long size = 0;
+  jpeg_mem_dest(&cinfo, &buffer, &size);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  while(cinfo.next_scanline < cinfo.image_height)
+  {
+    JSAMPROW row = &pixels[cinfo.next_scanline * width * 3];
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  bytes out(buffer, buffer + size);
+  jpeg_destroy_compress(&cinfo);
+  std::free(buffer);
+  return out;
+}
+
+// GIF
+
+int write_gif_bytes(GifFileType* gif, GifByteType const* data, int size)
+{
+  bytes& out = *static_cast<bytes*>(gif->UserData);
+  out.insert(out.end(), data, data + size);
+  return size;
+}
+
+// Interlaced images are written in the order of their four passes
+std::vector<std::size_t> gif_row_order(std::size_t height, bool interlaced)
+{
+  std::vector<std::size_t> order;
+  if(!interlaced)
+  {
+    for(std::size_t y = 0; y != height; ++y)
+      order.push_back(y);
+    return order;
+  }
+  std::size_t const starts[4] = {0, 4, 2, 1}, steps[4] = {8, 8, 4, 2};
+  for(std::size_t pass = 0; pass != 4; ++pass)
+    for(std::size_t y = starts[pass]; y < height; y += steps[pass])
+      order.push_back(y);
+  return order;
+}
+
+bytes make_gif(std::size_t width, std::size_t height, bool interlaced)
+{
+  bytes out;
+  GifColorType colors[256];
+  for(int i = 0; i != 256; ++i)
+  {
+    colors[i].Red = i;
+    colors[i].Green = 255 - i;
+    colors[i].Blue = (i * 7) & 0xFF;
+  }
+#if defined(GIFLIB_MAJOR) && GIFLIB_MAJOR >= 5
+  int error = 0;
+  GifFileType* gif = EGifOpen(&out, &write_gif_bytes, &error);
+  ColorMapObject* color_map = GifMakeMapObject(256, colors);
+#else
+  GifFileType* gif = EGifOpen(&out, &write_gif_bytes);
+  ColorMapObject* color_map = MakeMapObject(256, colors);
+#endif
+  if(!gif || !color_map)
+    throw std::runtime_error("Could not create GIF encoder");
+
+  EGifPutScreenDesc(gif, width, height, 8, 0, color_map);
+  EGifPutImageDesc(gif, 0, 0, width, height, interlaced, 0);
+  std::vector<GifPixelType> row(width);
+  std::vector<std::size_t> const order = gif_row_order(height, interlaced);
+  for(std::size_t i = 0; i != order.size(); ++i)
+  {
+    for(std::size_t x = 0; x != width; ++x)
+      row[x] = sample(x, order[i], 0);
+    EGifPutLine(gif, &row[0], width);
+  }
+#if defined(GIFLIB_MAJOR) && (GIFLIB_MAJOR > 5 || (GIFLIB_MAJOR == 5 && GIFLIB_MINOR >= 1))
+  EGifCloseFile(gif, &error);
+#else
+  EGifCloseFile(gif);
+#endif
+#if defined(GIFLIB_MAJOR) && GIFLIB_MAJOR >= 5
+  GifFreeMapObject(color_map);
+#else
+  FreeMapObject(color_map);
+#endif
+  return out;
+}
+
+// Cases
+
+struct image_case
+{
+  std::string name;
+  bytes encoded;
+  std::size_t min_width, min_height;
+};
+
+enum image_format { png_format, jpg_format, gif_format };
+
+void decode(image_format format, image_case const& c, bytes& rgba
+            , std::size_t& width, std::size_t& height)
+{
+  switch(format)
+  {
+  case png_format:
+    linux_::load_png_to_rgba(&c.encoded[0], c.encoded.size(), rgba, width, height);
+    break;
+  case jpg_format:
+    linux_::load_jpg_to_rgba(&c.encoded[0], c.encoded.size(), rgba, width, height
+                             , c.min_width, c.min_height);
+    break;
+  case gif_format:
+    {
+      // As the image cache does: every frame decoded, the first composed
+      boost::shared_ptr<linux_::gif_frames const> frames
+        = linux_::load_gif_frames(&c.encoded[0], c.encoded.size(), gif_composed_budget);
+      linux_::gif_animation const first(frames);
+      width = frames->width;
+      height = frames->height;
+      rgba.assign(first.pixels(), first.pixels() + 4u * width * height);
+    }
+    break;
+  }
+}
+
+std::string size_name(std::size_t width, std::size_t height)
+{
+  std::ostringstream name;
+  name << width << 'x' << height;
+  return name.str();
+}
+
+void print_header()
+{
+  std::cout << std::left << std::setw(36) << "case" << std::right
+            << std::setw(11) << "output" << std::setw(10) << "input KiB"
+            << std::setw(11) << "ms/image" << std::setw(10) << "MB/s" << std::endl;
+}
+
+void print_result(std::string const& name, std::size_t width, std::size_t height
+                  , std::size_t input_bytes, boost::int64_t microseconds, int runs)
+{
+  double const ms = microseconds / 1000.0 / runs;
+  double const megabytes = 4.0 * width * height / 1e6;
+  std::cout << std::left << std::setw(36) << name << std::right
+            << std::setw(11) << size_name(width, height)
+            << std::setw(10) << input_bytes / 1024
+            << std::setw(11) << std::fixed << std::setprecision(3) << ms
+            << std::setw(10) << std::setprecision(1) << megabytes / (ms / 1000.0) << std::endl;
+}
+
+void run_decoder(image_format format, image_case const& c)
+{
+  bytes rgba;
+  std::size_t width = 0, height = 0;
+  int runs = 0;
+  boost::int64_t const start = linux_::monotonic_microseconds();
+  boost::int64_t elapsed = 0;
+  do
+  {
+    decode(format, c, rgba, width, height);
+    ++runs;
+    elapsed = linux_::monotonic_microseconds() - start;
+  }
+  while(runs < min_runs || elapsed < min_microseconds);
+  print_result(c.name, width, height, c.encoded.size(), elapsed, runs);
+}
+
+typedef void (*cairo_conversion)(void*, int, int, int, std::vector<unsigned char>&);
+
+// Premultiplied ARGB32 in native endianness, with the row padding cairo
+// may add, half of it translucent like antialiased text
+void run_conversion(std::string const& name, cairo_conversion convert
+                    , std::size_t width, std::size_t height)
+{
+  std::size_t const stride = 4 * width + 64;
+  bytes surface(stride * height);
+  for(std::size_t y = 0; y != height; ++y)
+    for(std::size_t x = 0; x != width; ++x)
+    {
+      unsigned char* pixel = &surface[y * stride + 4 * x];
+      unsigned const alpha = x < width / 2 ? 0xFF : sample(x, y, 3);
+      for(std::size_t c = 0; c != 3; ++c)
+        pixel[c] = sample(x, y, c) * alpha / 0xFF;
+      pixel[3] = alpha;
+    }
+
+  bytes rgba;
+  int runs = 0;
+  boost::int64_t const start = linux_::monotonic_microseconds();
+  boost::int64_t elapsed = 0;
+  do
+  {
+    convert(&surface[0], width, height, stride, rgba);
+    ++runs;
+    elapsed = linux_::monotonic_microseconds() - start;
+  }
+  while(runs < min_runs || elapsed < min_microseconds);
+  print_result(name, width, height, surface.size(), elapsed, runs);
+}
+
+image_case make_case(std::string const& name, bytes const& encoded
+                     , std::size_t min_width = 0, std::size_t min_height = 0)
+{
+  image_case c;
+  c.name = name;
+  c.encoded = encoded;
+  c.min_width = min_width;
+  c.min_height = min_height;
+  return c;
+}
+
+}
+
+int main()
+{
+  std::srand(1);
+  print_header();
+
+  std::size_t const sizes[][2] = {{64, 64}, {256, 256}, {1280, 720}, {1920, 1080}};
+  std::size_t const size_count = sizeof(sizes) / sizeof(sizes[0]);
+
+  struct png_variant { char const* name; int color_type; bool interlaced; };
+  png_variant const png_variants[] =
+    {
+      {"png rgb", PNG_COLOR_TYPE_RGB, false}
+      , {"png rgba", PNG_COLOR_TYPE_RGB_ALPHA, false}
+      , {"png gray", PNG_COLOR_TYPE_GRAY, false}
+      , {"png palette", PNG_COLOR_TYPE_PALETTE, false}
+      , {"png rgba interlaced", PNG_COLOR_TYPE_RGB_ALPHA, true}
+    };
+  for(std::size_t v = 0; v != sizeof(png_variants) / sizeof(png_variants[0]); ++v)
+    for(std::size_t s = 0; s != size_count; ++s)
+      run_decoder(png_format, make_case(png_variants[v].name
+                                        , make_png(sizes[s][0], sizes[s][1]
+                                                   , png_variants[v].color_type
+                                                   , png_variants[v].interlaced)));
+
+  for(std::size_t s = 0; s != size_count; ++s)
+    run_decoder(jpg_format, make_case("jpg q85", make_jpg(sizes[s][0], sizes[s][1], 85)));
+  // Shown in a region half the size of the image, decoded at scale 1/2
+  run_decoder(jpg_format, make_case("jpg q85 into 960x540", make_jpg(1920, 1080, 85), 960, 540));
+  run_decoder(jpg_format, make_case("jpg q85 into 480x270", make_jpg(1920, 1080, 85), 480, 270));
+
+  for(std::size_t s = 0; s != size_count; ++s)
+  {
+    run_decoder(gif_format, make_case("gif", make_gif(sizes[s][0], sizes[s][1], false)));
+    run_decoder(gif_format, make_case("gif interlaced", make_gif(sizes[s][0], sizes[s][1], true)));
+  }
+
+  run_conversion("cairo to rgba", &linux_::rgba_from_cairo_ARGB32, 1920, 1080);
+  run_conversion("cairo to rgba, unpremultiplied"
+                 , &linux_::unpremultiplied_rgba_from_cairo_ARGB32, 1920, 1080);
+  run_conversion("cairo to bgra, unpremultiplied"
+                 , &linux_::unpremultiplied_bgra_from_cairo_ARGB32, 1920, 1080);
+  return 0;
+}
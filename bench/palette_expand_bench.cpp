@@ -0,0 +1,154 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Compares the composition of GIF frames done one pixel at a time with
+// the lookup table kernels of palette_expand.hpp, as compose_frame in
+// load_gif_linux.cpp uses them: each frame is drawn over the canvas,
+// skipping its transparent index, and restored to the background
+// before the next one.
+
+#include <ghtv/opengl/linux/palette_expand.hpp>
+#include <ghtv/opengl/linux/clock.hpp>
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+namespace linux_ = ghtv::opengl::linux_;
+
+namespace {
+
+struct color { unsigned char red, green, blue; };
+
+std::size_t const screen_width = 1280, screen_height = 720;
+std::size_t const left = 100, top = 50, width = 1000, height = 600;
+int const transparent_index = 7;
+int const iterations = 200;
+
+void per_pixel_draw(std::vector<unsigned char> const& indices, color const* palette
+                    , std::vector<unsigned char>& canvas)
+{
+  for(std::size_t y = 0; y != height; ++y)
+  {
+    unsigned char* canvas_row = &canvas[0] + 4u * ((top + y) * screen_width + left);
+    unsigned char const* index_row = &indices[0] + y * width;
+    for(std::size_t x = 0; x != width; ++x)
+    {
+      if(index_row[x] == transparent_index)
+        continue;
+      color const& c = palette[index_row[x]];
+      unsigned char* pixel = canvas_row + 4u * x;
+      pixel[0] = c.red;
+      pixel[1] = c.green;
+      pixel[2] = c.blue;
+      pixel[3] = 0xff;
+    }
+  }
+}
+
+// Disposal to the transparent background
+void per_pixel_dispose(std::vector<unsigned char>& canvas)
+{
+  for(std::size_t y = 0; y != height; ++y)
+  {
+    unsigned char* canvas_row = &canvas[0] + 4u * ((top + y) * screen_width + left);
+    for(std::size_t x = 0; x != width; ++x)
+    {
+      unsigned char* pixel = canvas_row + 4u * x;
+      pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+    }
+  }
+}
+
+void lookup_table_draw(std::vector<unsigned char> const& indices, unsigned char const* rgb
+                       , std::vector<unsigned char>& canvas)
+{
+  boost::uint32_t lut[linux_::palette_size];
+  linux_::make_palette_lut(rgb, linux_::palette_size, transparent_index, lut);
+  for(std::size_t y = 0; y != height; ++y)
+    linux_::expand_palette_over(&indices[0] + y * width, width, lut
+                                , &canvas[0] + 4u * ((top + y) * screen_width + left));
+}
+
+void lookup_table_dispose(std::vector<unsigned char>& canvas)
+{
+  for(std::size_t y = 0; y != height; ++y)
+    linux_::fill_rgba(&canvas[0] + 4u * ((top + y) * screen_width + left), width, 0);
+}
+
+}
+
+int main()
+{
+  std::vector<unsigned char> indices(width * height);
+  for(std::size_t i = 0; i != indices.size(); ++i)
+    indices[i] = std::rand() & 0xff;
+  color palette[linux_::palette_size];
+  std::vector<unsigned char> rgb(3u * linux_::palette_size);
+  for(std::size_t i = 0; i != linux_::palette_size; ++i)
+  {
+    color const c = {(unsigned char)(std::rand() & 0xff), (unsigned char)(std::rand() & 0xff)
+                     , (unsigned char)(std::rand() & 0xff)};
+    palette[i] = c;
+    rgb[3*i] = c.red; rgb[3*i + 1] = c.green; rgb[3*i + 2] = c.blue;
+  }
+
+  // The canvas holds the previous frame, which shows through the
+  // transparent pixels
+  std::vector<unsigned char> canvas(4u * screen_width * screen_height);
+  for(std::size_t i = 0; i != canvas.size(); ++i)
+    canvas[i] = std::rand() & 0xff;
+  std::vector<unsigned char> expected(canvas), actual(canvas);
+
+  per_pixel_draw(indices, palette, expected);
+  lookup_table_draw(indices, &rgb[0], actual);
+  if(expected != actual)
+  {
+    std::cerr << "lookup table frame differs from the per pixel one" << std::endl;
+    return 1;
+  }
+
+  boost::int64_t start = linux_::monotonic_microseconds();
+  for(int i = 0; i != iterations; ++i)
+  {
+    per_pixel_dispose(expected);
+    per_pixel_draw(indices, palette, expected);
+  }
+  boost::int64_t const per_pixel_time = linux_::monotonic_microseconds() - start;
+
+  start = linux_::monotonic_microseconds();
+  for(int i = 0; i != iterations; ++i)
+  {
+    lookup_table_dispose(actual);
+    lookup_table_draw(indices, &rgb[0], actual);
+  }
+  boost::int64_t const lookup_table_time = linux_::monotonic_microseconds() - start;
+
+  if(expected != actual)
+  {
+    std::cerr << "lookup table canvas differs from the per pixel one" << std::endl;
+    return 1;
+  }
+
+  double const pixels = double(width) * height * iterations;
+  std::cout << "per pixel:    " << per_pixel_time / iterations << " us/frame, "
+            << pixels / per_pixel_time << " Mpixel/s" << std::endl;
+  std::cout << "lookup table: " << lookup_table_time / iterations << " us/frame, "
+            << pixels / lookup_table_time << " Mpixel/s" << std::endl;
+  std::cout << "speedup:      " << double(per_pixel_time) / lookup_table_time << "x" << std::endl;
+  return 0;
+}
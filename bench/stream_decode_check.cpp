@@ -0,0 +1,360 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks the streaming PNG and JPEG decoders against the memory ones.
+// A server on a loopback port, run by this program, sends generated
+// images in small chunks with pauses between them, as a slow broadcast
+// carousel or network would. The RGBA decoded while the body arrives
+// must match, byte for byte, the RGBA decoded from the whole file, and
+// a body cut short must throw. Exits with failure if any check fails.
+
+#include <ghtv/opengl/linux/load_png.hpp>
+#include <ghtv/opengl/linux/load_jpg.hpp>
+#include <ghtv/opengl/linux/binary_file.hpp>
+
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <png.h>
+#include <jpeglib.h>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace linux_ = ghtv::opengl::linux_;
+
+namespace {
+
+typedef std::vector<unsigned char> bytes;
+
+std::size_t const chunk_size = 4096;
+// Long enough for the decoders to run out of input between chunks
+boost::posix_time::milliseconds const chunk_delay(2);
+
+unsigned char sample(std::size_t x, std::size_t y, std::size_t channel)
+{
+  return (x * (channel + 1) + y * (3 - channel) + (std::rand() & 15)) & 0xFF;
+}
+
+// PNG
+
+void write_png_bytes(png_structp png, png_bytep data, png_size_t size)
+{
+  bytes& out = *static_cast<bytes*>(png_get_io_ptr(png));
+  out.insert(out.end(), data, data + size);
+}
+
+void flush_png(png_structp)
+{
+}
+
+bytes make_png(std::size_t width, std::size_t height, int color_type, bool interlaced)
+{
+  std::size_t const channels = color_type == PNG_COLOR_TYPE_RGB_ALPHA ? 4 : 3;
+  bytes pixels(width * height * channels);
+  for(std::size_t y = 0; y != height; ++y)
+    for(std::size_t x = 0; x != width; ++x)
+      for(std::size_t c = 0; c != channels; ++c)
+        pixels[(y * width + x) * channels + c] = sample(x, y, c);
+
+  bytes out;
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+  png_infop info = png_create_info_struct(png);
+  png_set_write_fn(png, &out, &write_png_bytes, &flush_png);
+  png_set_IHDR(png, info, width, height, 8, color_type
+               , interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE
+               , PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  std::vector<png_bytep> rows(height);
+  for(std::size_t y = 0; y != height; ++y)
+    rows[y] = &pixels[y * width * channels];
+  png_set_rows(png, info, &rows[0]);
+  png_write_png(png, info, PNG_TRANSFORM_IDENTITY, 0);
+  png_destroy_write_struct(&png, &info);
+  return out;
+}
+
+// JPEG
+
+bytes make_jpg(std::size_t width, std::size_t height, bool progressive)
+{
+  bytes pixels(width * height * 3);
+  for(std::size_t y = 0; y != height; ++y)
+    for(std::size_t x = 0; x != width; ++x)
+      for(std::size_t c = 0; c != 3; ++c)
+        pixels[(y * width + x) * 3 + c] = sample(x, y, c);
+
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  unsigned char* buffer = 0;
+  unsigned long size = 0;
+  jpeg_mem_dest(&cinfo, &buffer, &size);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, 85, TRUE);
+  if(progressive)
+    jpeg_simple_progression(&cinfo);
+  jpeg_start_compress(&cinfo, TRUE);
+  while(cinfo.next_scanline < cinfo.image_height)
+  {
+    JSAMPROW row = &pixels[cinfo.next_scanline * width * 3];
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  bytes out(buffer, buffer + size);
+  jpeg_destroy_compress(&cinfo);
+  std::free(buffer);
+  return out;
+}
+
+// HTTP stand-in
+
+bool send_all(int socket, unsigned char const* data, std::size_t size)
+{
+  while(size)
+  {
+    ssize_t const sent = ::send(socket, data, size, MSG_NOSIGNAL);
+    if(sent <= 0)
+      return false;
+    data += sent;
+    size -= sent;
+  }
+  return true;
+}
+
+// Serves GET requests for the files it is given, over HTTP/1.0 so every
+// response ends with its connection. Paths starting with /truncated
+// announce the whole file but only send half of it.
+struct slow_server
+{
+  slow_server()
+    : listener(::socket(AF_INET, SOCK_STREAM, 0)), port(0)
+  {
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if(listener < 0
+       || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+       || ::listen(listener, 8) != 0
+       || ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+      throw std::runtime_error("Could not listen on a loopback port");
+    port = ntohs(address.sin_port);
+  }
+
+  ~slow_server()
+  {
+    // Wakes accept up, which then fails and ends the thread
+    ::shutdown(listener, SHUT_RDWR);
+    ::close(listener);
+    if(thread)
+      thread->join();
+  }
+
+  void start()
+  {
+    thread.reset(new boost::thread(&slow_server::run, this));
+  }
+
+  std::string url(std::string const& path) const
+  {
+    return "http://127.0.0.1:" + boost::lexical_cast<std::string>(port) + path;
+  }
+
+  void run()
+  {
+    for(;;)
+    {
+      int const connection = ::accept(listener, 0, 0);
+      if(connection < 0)
+        return;
+      respond(connection);
+      ::close(connection);
+    }
+  }
+
+  void respond(int connection)
+  {
+    std::string request;
+    char buffer[1024];
+    while(request.find("\r\n\r\n") == std::string::npos)
+    {
+      ssize_t const received = ::recv(connection, buffer, sizeof(buffer), 0);
+      if(received <= 0)
+        return;
+      request.append(buffer, received);
+    }
+
+    std::string::size_type const path_begin = request.find(' ') + 1;
+    std::string path = request.substr(path_begin, request.find(' ', path_begin) - path_begin);
+    bool const truncated = path.compare(0, 10, "/truncated") == 0;
+    if(truncated)
+      path = path.substr(10);
+
+    std::map<std::string, bytes>::const_iterator file = files.find(path);
+    if(file == files.end())
+    {
+      std::string const not_found = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+      send_all(connection, reinterpret_cast<unsigned char const*>(not_found.data()), not_found.size());
+      return;
+    }
+
+    std::string const header = "HTTP/1.0 200 OK\r\nContent-Length: "
+      + boost::lexical_cast<std::string>(file->second.size()) + "\r\n\r\n";
+    if(!send_all(connection, reinterpret_cast<unsigned char const*>(header.data()), header.size()))
+      return;
+    std::size_t const size = truncated ? file->second.size() / 2 : file->second.size();
+    for(std::size_t offset = 0; offset < size; offset += chunk_size)
+    {
+      if(!send_all(connection, &file->second[offset], std::min(chunk_size, size - offset)))
+        return;
+      boost::this_thread::sleep(chunk_delay);
+    }
+  }
+
+  /// Paths, as requested, to the bytes served for them
+  std::map<std::string, bytes> files;
+  int listener;
+  unsigned short port;
+  boost::shared_ptr<boost::thread> thread;
+};
+
+// Checks
+
+int failures = 0;
+
+void report(std::string const& name, bool passed, std::string const& detail = std::string())
+{
+  std::cout << (passed ? "PASS " : "FAIL ") << name;
+  if(!detail.empty())
+    std::cout << ": " << detail;
+  std::cout << std::endl;
+  if(!passed)
+    ++failures;
+}
+
+void decode(linux_::binary_file const& file, bool png, std::size_t min_width, std::size_t min_height
+            , bytes& data, std::size_t& width, std::size_t& height)
+{
+  if(png)
+    linux_::load_png_to_rgba(file, data, width, height);
+  else
+    linux_::load_jpg_to_rgba(file, data, width, height, min_width, min_height);
+}
+
+void decode(bytes const& file, bool png, std::size_t min_width, std::size_t min_height
+            , bytes& data, std::size_t& width, std::size_t& height)
+{
+  if(png)
+    linux_::load_png_to_rgba(&file[0], file.size(), data, width, height);
+  else
+    linux_::load_jpg_to_rgba(&file[0], file.size(), data, width, height, min_width, min_height);
+}
+
+void check_streamed(slow_server const& server, std::string const& path
+                    , std::size_t min_width = 0, std::size_t min_height = 0)
+{
+  std::string name = "streamed " + path.substr(1);
+  if(min_width)
+    name += " into " + boost::lexical_cast<std::string>(min_width)
+      + 'x' + boost::lexical_cast<std::string>(min_height);
+  bool const png = path.find(".png") != std::string::npos;
+  try
+  {
+    bytes expected, streamed;
+    std::size_t expected_width = 0, expected_height = 0, width = 0, height = 0;
+    decode(server.files.find(path)->second, png, min_width, min_height
+           , expected, expected_width, expected_height);
+    linux_::binary_file const remote(linux_::binary_file::system_file_t(), server.url(path));
+    decode(remote, png, min_width, min_height, streamed, width, height);
+
+    if(width != expected_width || height != expected_height)
+      report(name, false, "decoded " + boost::lexical_cast<std::string>(width) + 'x'
+             + boost::lexical_cast<std::string>(height) + " instead of "
+             + boost::lexical_cast<std::string>(expected_width) + 'x'
+             + boost::lexical_cast<std::string>(expected_height));
+    else if(streamed != expected)
+    {
+      std::size_t const first = std::mismatch(streamed.begin(), streamed.end(), expected.begin()).first
+        - streamed.begin();
+      report(name, false, "RGBA differs from byte " + boost::lexical_cast<std::string>(first));
+    }
+    else
+      report(name, true);
+  }
+  catch(std::exception const& e)
+  {
+    report(name, false, e.what());
+  }
+}
+
+void check_truncated(slow_server const& server, std::string const& path)
+{
+  std::string const name = "truncated " + path.substr(1);
+  try
+  {
+    bytes data;
+    std::size_t width = 0, height = 0;
+    linux_::binary_file const remote(linux_::binary_file::system_file_t(), server.url("/truncated" + path));
+    decode(remote, path.find(".png") != std::string::npos, 0, 0, data, width, height);
+    report(name, false, "decoded without an error");
+  }
+  catch(std::exception const& e)
+  {
+    report(name, true, e.what());
+  }
+}
+
+}
+
+int main()
+{
+  linux_::binary_file::initialize_binary_files();
+
+  slow_server server;
+  server.files["/rgb.png"] = make_png(640, 480, PNG_COLOR_TYPE_RGB, false);
+  server.files["/interlaced.png"] = make_png(640, 480, PNG_COLOR_TYPE_RGB_ALPHA, true);
+  server.files["/baseline.jpg"] = make_jpg(1280, 720, false);
+  server.files["/progressive.jpg"] = make_jpg(1280, 720, true);
+  server.start();
+
+  check_streamed(server, "/rgb.png");
+  check_streamed(server, "/interlaced.png");
+  check_streamed(server, "/baseline.jpg");
+  check_streamed(server, "/baseline.jpg", 640, 360);
+  check_streamed(server, "/progressive.jpg");
+  check_truncated(server, "/rgb.png");
+  check_truncated(server, "/baseline.jpg");
+
+  std::cout << (failures ? "FAILED" : "All checks passed") << std::endl;
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_ANIMATION_HPP
+#define GHTV_OPENGL_LINUX_ANIMATION_HPP
+
+#include <boost/cstdint.hpp>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Something that changes as time passes, like an animated image. The
+/// registered animations are advanced by @ref draw, which then schedules
+/// a redraw for the earliest time one changes next.
+///
+/// @note Animations are registered, unregistered and run on the thread
+/// that draws.
+struct animation
+{
+  virtual ~animation() {}
+
+  /// Updates the animation for @p now, in monotonic microseconds, and
+  /// returns when it changes next.
+  virtual boost::int64_t animate(boost::int64_t now) = 0;
+};
+
+void register_animation(animation* a);
+void unregister_animation(animation* a);
+
+/// Animates every registered animation, returning the earliest time one
+/// changes next, or zero if there are none.
+boost::int64_t run_animations(boost::int64_t now);
+
+} } }
+
+#endif
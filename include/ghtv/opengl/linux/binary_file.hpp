@@ -17,17 +17,49 @@
 #ifndef GHTV_OPENGL_LINUX_BINARY_FILE_HPP
 #define GHTV_OPENGL_LINUX_BINARY_FILE_HPP
 
+#include <boost/shared_ptr.hpp>
+
 #include <vector>
 #include <string>
+#include <cstddef>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
+/// Receives the content of a @ref binary_file while it is read.
+struct content_sink
+{
+  virtual ~content_sink() {}
+  /// Called with each piece of the content, in order.
+  virtual void consume(unsigned char const* bytes, std::size_t size) = 0;
+};
+
+/// Immutable content of a file. Copies share the bytes, which live as
+/// long as any copy does: a read-only mapping for local files, a buffer
+/// for downloads.
+struct shared_content
+{
+  shared_content() : bytes(0), length(0) {}
+  /// @p owner keeps the @p size bytes at @p data alive.
+  shared_content(boost::shared_ptr<void const> const& owner, char const* data, std::size_t size)
+    : owner(owner), bytes(data), length(size) {}
+
+  /// Null if empty
+  char const* data() const { return bytes; }
+  std::size_t size() const { return length; }
+  bool empty() const { return length == 0; }
+
+private:
+  boost::shared_ptr<void const> owner;
+  char const* bytes;
+  std::size_t length;
+};
+
 /// Class for handling local and web files across the program.
 /// All its member functions are synchronous, they will block and return only
 /// when the operation is completed or a exception is thrown.
 struct binary_file
 {
-  typedef std::vector<char> content; ///< Shortcut for vector of characters
+  typedef shared_content content; ///< Shared between copies
   struct system_file_t {}; ///< Empty type for explicitly use the "system file" version of the constructor.
 
   binary_file(std::string const& ncl_root, std::string const& source_uri);
@@ -39,15 +71,25 @@ struct binary_file
 
   ~binary_file();
 
+  /// Copies share the loaded content.
   binary_file(binary_file const& other);
   binary_file& operator=(binary_file const& other);
 
+  /// Local files are mapped rather than read.
   /// @throw std::runtime_error if resource could not be read.
   void load_content();
   /// Same as @ref load_content but add '\0' at the end.
   void load_content_as_c_str();
+  /// Releases the content for this object, copies keep theirs.
   void release_content();
 
+  /// Passes the content to @p sink as it is downloaded, so it can be
+  /// processed while the rest is still on its way. Loaded content and
+  /// local files are passed in one piece. Nothing is kept in the object.
+  /// @throw std::runtime_error if resource could not be read, or what
+  /// @p sink throws.
+  void stream_content(content_sink& sink) const;
+
   /// @note Invoke @ref load_content before.
   content const& file_content() const;
   /// @note Invoke @ref load_content before.
@@ -75,6 +117,24 @@ private:
   binary_file_impl* impl;
 };
 
+/// The content of a @ref binary_file for decoders that only read it. A
+/// file whose content is already loaded shares it; otherwise it is
+/// loaded here.
+/// @throw std::runtime_error if resource could not be read.
+struct file_bytes
+{
+  explicit file_bytes(binary_file const& file);
+
+  unsigned char const* data() const;
+  std::size_t size() const;
+
+private:
+  binary_file::content content;
+
+  file_bytes(file_bytes const&);
+  file_bytes& operator=(file_bytes const&);
+};
+
 } } }
 
 #endif
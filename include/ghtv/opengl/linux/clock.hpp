@@ -14,20 +14,23 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef LOAD_IMAGE_HPP
-#define LOAD_IMAGE_HPP
+#ifndef GHTV_OPENGL_LINUX_CLOCK_HPP
+#define GHTV_OPENGL_LINUX_CLOCK_HPP
 
-#include <ghtv/opengl/linux/binary_file.hpp>
+#include <boost/cstdint.hpp>
 
-#include <ghtv/opengl/texture.hpp>
-
-#include <vector>
+#include <time.h>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
-void load_image_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height);
-
-texture load_image(binary_file const& file);
+/// Microseconds from CLOCK_MONOTONIC. Only differences between two values
+/// are meaningful.
+inline boost::int64_t monotonic_microseconds()
+{
+  timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return boost::int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
 
 } } }
 
@@ -0,0 +1,170 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_COMPOSITOR_HPP
+#define GHTV_OPENGL_LINUX_COMPOSITOR_HPP
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#endif
+
+#include <ghtv/opengl/texture.hpp>
+#include <ghtv/opengl/player_base.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Screen rectangle in pixels, top-left origin. right and bottom are
+/// exclusive.
+struct screen_rect
+{
+  int left, top, right, bottom;
+
+  screen_rect()
+    : left(0), top(0), right(0), bottom(0)
+  {}
+  screen_rect(int left, int top, int right, int bottom)
+    : left(left), top(top), right(right), bottom(bottom)
+  {}
+
+  bool empty() const
+  {
+    return right <= left || bottom <= top;
+  }
+
+  /// Grows this rectangle to the bounding box of both.
+  void merge(screen_rect const& other)
+  {
+    if(other.empty())
+      return;
+    if(empty())
+    {
+      *this = other;
+      return;
+    }
+    left = (std::min)(left, other.left);
+    top = (std::min)(top, other.top);
+    right = (std::max)(right, other.right);
+    bottom = (std::max)(bottom, other.bottom);
+  }
+
+  bool intersects(screen_rect const& other) const
+  {
+    return left < other.right && other.left < right
+      && top < other.bottom && other.top < bottom;
+  }
+
+  screen_rect intersection(screen_rect const& other) const
+  {
+    screen_rect r((std::max)(left, other.left), (std::max)(top, other.top)
+                  , (std::min)(right, other.right), (std::min)(bottom, other.bottom));
+    return r.empty() ? screen_rect() : r;
+  }
+
+  bool operator==(screen_rect const& other) const
+  {
+    return left == other.left && top == other.top
+      && right == other.right && bottom == other.bottom;
+  }
+  bool operator!=(screen_rect const& other) const
+  {
+    return !(*this == other);
+  }
+};
+
+/// Snapshot of one textured quad of a frame. Everything that affects the
+/// pixels it produces is copied, so two frames can be compared.
+struct draw_record
+{
+  /// Player that owns texture, set by the display list
+  opengl::player_base* player;
+  opengl::texture* texture;
+  GLuint texture_id;
+  int zindex;
+  /// Position and size of the texture itself
+  int x, y, width, height;
+  int border_size;
+  GLfloat border_color[3];
+  int clip[4];
+  /// Sub-rectangle of the GL texture holding the image, for atlas pages
+  GLfloat uv[4];
+  /// The texture has no transparent pixels
+  bool opaque;
+  /// Area covered on screen, border included
+  screen_rect bounds;
+
+  bool same_contents(draw_record const& other) const
+  {
+    return texture_id == other.texture_id && zindex == other.zindex
+      && x == other.x && y == other.y
+      && width == other.width && height == other.height
+      && border_size == other.border_size
+      && std::equal(border_color, border_color + 3, other.border_color)
+      && std::equal(clip, clip + 4, other.clip)
+      && std::equal(uv, uv + 4, other.uv)
+      && opaque == other.opaque;
+  }
+};
+
+draw_record make_draw_record(opengl::texture& texture, int x, int y, int zindex);
+
+/// Whether the clip rectangle of @p record hides part of its texture.
+bool is_clipped(draw_record const& record);
+
+/// Whether @p record covers all its bounds with opaque pixels, so it can be
+/// drawn without blending and hides whatever is below it.
+bool draws_opaque(draw_record const& record);
+
+/// Fills @p visible with the indices, in order, of the @p records that may
+/// show in @p repaint. Records entirely outside it, or entirely behind a
+/// single opaque record drawn after them, are left out.
+/// @param undamaged Set to the number of records left out only because
+/// they are outside @p repaint, though on screen.
+/// @return The number of records culled: off-screen or occluded.
+std::size_t cull_records(std::vector<draw_record> const& records, screen_rect const& repaint
+                         , std::vector<std::size_t>& visible, std::size_t& undamaged);
+
+/// Tells the compositor that the pixels of @p texture changed even though
+/// the texture object is the same. Call from the rendering thread, usually
+/// right after uploading.
+void note_texture_update(opengl::texture const& texture);
+
+/// Forces the next frame to be repainted completely.
+void damage_screen();
+
+/// Compares @p records with the ones from the previous frame and returns
+/// the bounding box of everything that changed, clipped to the screen.
+/// An empty rectangle means the frame can be skipped.
+/// @param records_changed false if @p records are known to be the same as
+/// in the previous frame, which skips the comparison.
+screen_rect compute_damage(std::vector<draw_record> const& records, bool records_changed);
+
+/// Prepares the back buffer for repainting @p damage. Returns the area that
+/// must actually be repainted, which is larger than @p damage when the back
+/// buffer holds an older frame, and sets the scissor box to it.
+screen_rect begin_frame(screen_rect const& damage);
+
+/// Swaps buffers, passing @p damage to the window system when supported.
+void end_frame(screen_rect const& damage);
+
+} } }
+
+#endif
@@ -0,0 +1,54 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_DISK_IMAGE_CACHE_HPP
+#define GHTV_OPENGL_LINUX_DISK_IMAGE_CACHE_HPP
+
+#include <ghtv/opengl/linux/image_cache.hpp>
+
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+#include <ostream>
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Keeps decoded images in @p directory, created if needed, across runs
+/// of the player, up to @p budget bytes. Files left by earlier runs are
+/// scanned, and the least recently used removed above the budget. Off
+/// until called.
+void enable_disk_image_cache(std::string const& directory, std::size_t budget);
+
+/// Whether @ref enable_disk_image_cache was called.
+bool disk_image_cache_enabled();
+
+/// Maps the image stored under @p key, whose pixels are then read
+/// straight from the page cache. Null if there is none or it does not
+/// match @p key. Can be called from any thread.
+boost::shared_ptr<decoded_image const> load_disk_cached_image(std::string const& key);
+
+/// Stores the RGBA pixels of @p image under @p key, removing the least
+/// recently used images above the budget. Failures are reported and
+/// otherwise ignored. Can be called from any thread.
+void store_disk_cached_image(std::string const& key, decoded_image const& image);
+
+/// Prints the hits, misses and size of the disk cache, if enabled.
+void print_disk_image_cache_statistics(std::ostream& os);
+
+} } }
+
+#endif
@@ -0,0 +1,88 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_DISPLAY_LIST_HPP
+#define GHTV_OPENGL_LINUX_DISPLAY_LIST_HPP
+
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/player_base.hpp>
+
+#include <boost/weak_ptr.hpp>
+
+#include <vector>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Tells the display list that the pixels or textures of @p player
+/// changed. Only the records of that player are generated again on the
+/// next update. May be called from any thread; @p player is never
+/// dereferenced, a player that is gone is simply not found.
+void request_texture_refresh(opengl::player_base const* player);
+
+/// Tells the display list that players may have started or stopped, or
+/// changed their geometry or visibility, so it is built again from the
+/// active players on the next update. Called once events were handled.
+void invalidate_display_list();
+
+/// Draw records of every visible player, sorted by z-index.
+///
+/// The records are kept from frame to frame. The active players are only
+/// walked again after @ref invalidate_display_list, and otherwise only
+/// the players that signalled @ref request_texture_refresh are asked for
+/// their textures, so a frame where nothing changed costs nothing.
+struct display_list
+{
+  display_list();
+
+  /// Brings the records up to date with the active players. Returns true
+  /// if any record changed since the last call. Players whose records
+  /// stay the same after a refresh have their textures given to
+  /// @ref note_texture_update instead.
+  bool update();
+
+  std::vector<draw_record> const& records() const { return records_; }
+
+  std::size_t rebuilds() const { return rebuild_count; }
+
+private:
+  /// A player with records, which are contiguous in the sorted list
+  struct player_entry
+  {
+    /// Tells a player from another one later created at the same address
+    boost::weak_ptr<opengl::player_base> player;
+    opengl::player_base const* address;
+    int x, y, zindex;
+    bool visible;
+    std::size_t first, count;
+  };
+
+  static bool zindex_less(player_entry const& lhs, player_entry const& rhs);
+
+  void rebuild();
+  /// Generates the records of @p entry again. Returns false if their
+  /// number changed, or the player is gone, and the list must be rebuilt.
+  bool refresh(player_entry const& entry, bool& changed);
+
+  std::vector<player_entry> entries;
+  std::vector<draw_record> records_;
+  /// Players that asked for a refresh, taken on each update
+  std::vector<opengl::player_base const*> requested;
+  std::size_t rebuild_count;
+};
+
+} } }
+
+#endif
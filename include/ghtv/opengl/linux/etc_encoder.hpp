@@ -0,0 +1,40 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_ETC_ENCODER_HPP
+#define GHTV_OPENGL_LINUX_ETC_ENCODER_HPP
+
+#include <ghtv/opengl/linux/ktx.hpp>
+
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Compresses a @p width x @p height RGBA image to ETC1, dropping alpha.
+/// Every block is searched exhaustively over both split orientations,
+/// both base color modes and all modifier tables: slow, but meant to be
+/// run offline.
+void compress_etc1(unsigned char const* rgba, std::size_t width, std::size_t height
+                   , compressed_image& image);
+
+/// Compresses a @p width x @p height RGBA image to ETC2 RGBA8, whose
+/// color blocks are the ETC1 ones and whose alpha goes to EAC blocks.
+void compress_etc2_eac(unsigned char const* rgba, std::size_t width, std::size_t height
+                       , compressed_image& image);
+
+} } }
+
+#endif
@@ -0,0 +1,44 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_EVENT_LOOP_HPP
+#define GHTV_OPENGL_LINUX_EVENT_LOOP_HPP
+
+#include <boost/function.hpp>
+
+#include <linux/input.h>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Returns true if the event was handled and a redraw may be needed.
+typedef boost::function<bool(input_event const&)> input_event_handler;
+
+/// Main loop for the EGL builds.
+///
+/// Sleeps in epoll until the input device, the @ref wakeup_fd from
+/// idle_update or the frame timer is ready, so no CPU is used while idle.
+/// Redraws are coalesced so that at most one frame is presented every
+/// @p frame_interval_ms; a redraw request waits at most that long plus the
+/// time spent in @ref draw.
+///
+/// @param input_fd A /dev/input/* file descriptor.
+/// @return The process exit status.
+int run_event_loop(int input_fd, input_event_handler const& handler
+                   , unsigned int frame_interval_ms);
+
+} } }
+
+#endif
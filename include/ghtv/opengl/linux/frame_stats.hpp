@@ -0,0 +1,88 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_FRAME_STATS_HPP
+#define GHTV_OPENGL_LINUX_FRAME_STATS_HPP
+
+#include <ghtv/opengl/linux/clock.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <ostream>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+enum frame_stat
+{
+  frame_time_stat        ///< CPU time spent in draw()
+  , gpu_frame_time_stat  ///< GPU time of the commands issued by draw()
+  , events_time_stat     ///< CPU time spent in handle_events()
+  , upload_time_stat     ///< CPU time of each texture upload
+  , decode_time_stat     ///< CPU time of each image decode
+  , present_latency_stat ///< From the first redraw request to the buffer swap
+  , frame_stat_count
+};
+
+enum frame_counter
+{
+  drawn_quads_counter
+  , culled_quads_counter ///< Off-screen or behind an opaque quad
+  , undamaged_quads_counter ///< On screen but outside the repainted area
+  , draw_calls_counter
+  , frame_counter_count
+};
+
+/// Adds the count of one frame to @p counter.
+void add_frame_counter(frame_counter counter, std::size_t value);
+
+/// Adds a sample, in microseconds, to the rolling histogram of @p stat.
+/// Can be called from any thread.
+void record_frame_stat(frame_stat stat, boost::int64_t microseconds);
+
+/// Records the CPU time between its construction and destruction.
+struct scoped_stat_timer
+{
+  explicit scoped_stat_timer(frame_stat stat)
+    : stat(stat), start(monotonic_microseconds())
+  {}
+  ~scoped_stat_timer()
+  {
+    record_frame_stat(stat, monotonic_microseconds() - start);
+  }
+private:
+  frame_stat stat;
+  boost::int64_t start;
+};
+
+/// Brackets the GL commands of a frame with a GL_EXT_disjoint_timer_query
+/// or GL_ARB_timer_query time elapsed query. Results are collected in later
+/// frames without stalling the pipeline. Does nothing if neither extension
+/// exists. Must be called from the rendering thread.
+void begin_gpu_timer();
+void end_gpu_timer();
+
+/// Prints p50/p95/p99/max of the last samples of every stat, and the
+/// totals and per frame averages of the counters.
+void print_frame_stats(std::ostream& os);
+
+/// Makes SIGUSR1 request a dump of the frame stats, which the main loop
+/// prints through @ref print_frame_stats_if_requested.
+void install_frame_stats_signal_handler();
+void print_frame_stats_if_requested(std::ostream& os);
+
+} } }
+
+#endif
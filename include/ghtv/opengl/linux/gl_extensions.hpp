@@ -0,0 +1,37 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_GL_EXTENSIONS_HPP
+#define GHTV_OPENGL_LINUX_GL_EXTENSIONS_HPP
+
+#include <string>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Whether the current context advertises the GL extension @p name.
+bool has_gl_extension(std::string const& name);
+
+/// Whether the current context is OpenGL ES (otherwise desktop OpenGL) of
+/// at least version @p major.@p minor.
+bool gl_version_at_least(bool es, int major, int minor);
+
+/// Address of a GL entry point, through EGL or GLX depending on the build.
+/// Returns 0 if it does not exist.
+void* get_gl_proc_address(std::string const& name);
+
+} } }
+
+#endif
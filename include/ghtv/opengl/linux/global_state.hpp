@@ -25,6 +25,9 @@
 #ifdef  GHTV_USE_OPENMAX
 #include <ghtv/omx-rpi/image_pipeline.hpp>
 #endif
+#ifndef GHTV_USE_GLUT
+#include <EGL/egl.h>
+#endif
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -49,9 +52,6 @@ struct state
   main_state_type main_state;
 
   boost::shared_ptr<gntl::parser::libxml2::dom::xml_document> xml_document;
-  GLuint program_object;
-  GLint projection_location, z_location, texture_location
-    , border_color_location, clip_location;
   int width, height;
 #ifdef GHTV_USE_OPENMAX
   boost::mutex pipeline_mutex;
@@ -62,14 +62,20 @@ struct state
   std::vector<image_pipeline> free_image_pipelines;
   std::vector<image_pipeline> reset_image_pipelines;
   std::list<image_pipeline> busy_image_pipelines;
-
+#endif
+#ifndef GHTV_USE_GLUT
   EGLDisplay egl_display;
   EGLContext egl_context;
   EGLSurface egl_surface;
+#endif
+#ifdef GHTV_BCM_HOST
   EGL_DISPMANX_WINDOW_T nativewindow;
 #endif
 
   state() : width(1280), height(720)
+#ifndef GHTV_USE_GLUT
+    , egl_display(EGL_NO_DISPLAY), egl_context(EGL_NO_CONTEXT), egl_surface(EGL_NO_SURFACE)
+#endif
   {}
 };
 
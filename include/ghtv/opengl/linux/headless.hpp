@@ -0,0 +1,46 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_HEADLESS_HPP
+#define GHTV_OPENGL_LINUX_HEADLESS_HPP
+
+#include <string>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Makes current an offscreen OpenGL ES 2.0 context of
+/// global_state.width x global_state.height, needing neither a GPU nor a
+/// display server (e.g. Mesa llvmpipe).
+///
+/// Uses the EGL_MESA_platform_surfaceless display when available and
+/// renders into a pbuffer, or into a framebuffer object on a surfaceless
+/// context if the EGL implementation has no pbuffer configs.
+/// @return false, after printing the reason, on failure.
+bool create_headless_context();
+
+/// Main loop for the headless build.
+///
+/// Renders @p frames full frames, @p frame_interval_ms apart so timers and
+/// asynchronous loads progress as they would on screen, and prints the
+/// time spent rendering each frame. If @p dump_dir is not empty every frame
+/// is written there as frame-NNNNN.png.
+/// @return The process exit status.
+int run_headless_loop(unsigned int frames, unsigned int frame_interval_ms
+                      , std::string const& dump_dir);
+
+} } }
+
+#endif
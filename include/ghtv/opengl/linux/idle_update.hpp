@@ -18,15 +18,38 @@
 #define GHTV_OPENGL_LINUX_IDLE_UPDATE_HPP
 
 #include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
 // TODO Better names?
-// TODO Raspeberry py ifdefs
 void glut_idle_update_function();
 void async_redraw();
 void async_signal_new_event();
 
+/// Requests a redraw at @p time, in monotonic microseconds, for
+/// animations. Only the earliest requested time is kept.
+void schedule_redraw(boost::int64_t time);
+/// Turns the scheduled redraw into a pending one if its time has come.
+/// Returns the time of the scheduled redraw still to come, or zero.
+boost::int64_t poll_scheduled_redraw(boost::int64_t now);
+
+#ifndef GHTV_USE_GLUT
+/// eventfd that becomes readable whenever @ref async_redraw or
+/// @ref async_signal_new_event is called, so the main loop can sleep on it.
+int wakeup_fd();
+/// Resets the @ref wakeup_fd counter.
+void drain_wakeup_fd();
+
+/// Returns true, and clears the flag, if @ref async_signal_new_event was
+/// called since the last call.
+bool consume_new_events();
+bool redraw_pending();
+/// Clears the redraw flag and returns the monotonic time, in microseconds,
+/// of the first @ref async_redraw since the last call.
+boost::int64_t consume_redraw();
+#endif
+
 } } }
 
 #endif
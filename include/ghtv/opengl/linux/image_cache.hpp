@@ -0,0 +1,154 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_IMAGE_CACHE_HPP
+#define GHTV_OPENGL_LINUX_IMAGE_CACHE_HPP
+
+#include <ghtv/opengl/linux/binary_file.hpp>
+#include <ghtv/opengl/linux/load_gif.hpp>
+#include <ghtv/opengl/linux/ktx.hpp>
+#include <ghtv/opengl/linux/mapped_file.hpp>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/cstdint.hpp>
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// An image decoded to RGBA, or loaded compressed, ready to be uploaded.
+struct decoded_image
+{
+  decoded_image()
+    : width(0), height(0), opaque(false), mapped_pixels(0)
+  {}
+
+  /// Bytes of pixels, and of the frames if animated
+  std::size_t memory() const
+  {
+    return rgba.size() + (frames ? frames->memory() : 0)
+      + (compressed ? compressed->data.size() : 0)
+      + (mapped ? 4 * width * height : 0);
+  }
+
+  /// The RGBA pixels, decoded or mapped from the disk cache. Null if
+  /// compressed.
+  unsigned char const* pixels() const
+  {
+    return mapped_pixels ? mapped_pixels : rgba.empty() ? 0 : &rgba[0];
+  }
+
+  /// The first frame if animated, empty if compressed or mapped
+  std::vector<unsigned char> rgba;
+  std::size_t width, height;
+  /// Every pixel has alpha 1
+  bool opaque;
+  /// Every frame of an animated GIF, null for other images
+  boost::shared_ptr<gif_frames const> frames;
+  /// The KTX sidecar of the image, null if it was decoded
+  boost::shared_ptr<compressed_image const> compressed;
+  /// The disk cache file the pixels are read from, null if decoded
+  boost::shared_ptr<mapped_file const> mapped;
+  unsigned char const* mapped_pixels;
+};
+
+/// An image of the document and the size it is shown at, zero if unknown.
+struct image_source
+{
+  std::string source;
+  std::size_t width, height;
+};
+
+/// Whether @p source is decoded in software by this build, instead of
+/// by the OpenMAX pipeline.
+bool software_decodable(std::string const& source);
+
+/// Decodes @p file in software. Can be called from any thread. Formats
+/// that can decode at a reduced scale, like JPEG, are decoded at the
+/// smallest one at least @p min_width x @p min_height.
+///
+/// An image that will only be a @p texture is loaded from its KTX
+/// sidecar instead, when there is one at least as recent as the image in
+/// one of the formats given to @ref set_compressed_texture_formats, that
+/// is no larger than the decode at the requested size.
+/// @throw std::runtime_error if it is not a supported image or could
+/// not be decoded.
+boost::shared_ptr<decoded_image const> decode_image
+  (binary_file const& file, std::size_t min_width = 0, std::size_t min_height = 0
+   , bool texture = false);
+
+/// Returns the decoded image of @p file from the cache shared by every
+/// player, decoding it on a miss. Local files are keyed by canonical path
+/// and modification time, so a changed file is decoded again. When the
+/// same image is already being decoded by another thread, waits for it
+/// instead. Can be called from any thread. Images decoded at a reduced
+/// scale are cached apart for each minimum size, and @p texture images
+/// apart from others. Whether a texture comes from its KTX sidecar is
+/// decided on the miss and kept with the entry.
+/// @throw std::runtime_error as @ref decode_image.
+boost::shared_ptr<decoded_image const> load_cached_image
+  (binary_file const& file, std::size_t min_width = 0, std::size_t min_height = 0
+   , bool texture = false);
+
+/// Returns the decoded image of @p file if it is in the cache, without
+/// decoding it or waiting for it. Null otherwise.
+boost::shared_ptr<decoded_image const> find_cached_image
+  (binary_file const& file, std::size_t min_width = 0, std::size_t min_height = 0
+   , bool texture = false);
+
+typedef boost::function<void(boost::shared_ptr<decoded_image const> const&)>
+  image_ready_callback;
+
+/// Decodes @p file through the cache on the decoder threads, as a
+/// texture and ahead of prefetches, and queues @p ready to be called by
+/// @ref deliver_decoded_images. Images that fail are reported and their
+/// callback dropped.
+void decode_image_async(binary_file const& file, std::size_t min_width, std::size_t min_height
+                        , image_ready_callback const& ready);
+
+/// Calls, on the render thread, the callbacks of images decoded by
+/// @ref decode_image_async, until their pixels add up to @p budget bytes.
+/// At least one is delivered. A redraw is requested if some are left, so
+/// uploads are spread over frames.
+void deliver_decoded_images(std::size_t budget);
+
+/// Sets the compressed formats the GL context can sample, which KTX
+/// sidecars may be in. None until called, which must be before decoding
+/// starts.
+void set_compressed_texture_formats(std::vector<boost::uint32_t> const& formats);
+
+/// Sets how many bytes of decoded pixels the cache keeps. Least recently
+/// used images are evicted above it; players still showing one keep it
+/// alive.
+void set_image_cache_budget(std::size_t bytes);
+
+/// Prints the hits, misses, evictions and size of the image cache.
+void print_image_cache_statistics(std::ostream& os);
+
+/// Starts decoding @p sources, relative to the NCL @p root, into the
+/// image cache as textures on a pool of threads. Returns immediately.
+void prefetch_images(std::string const& root, std::vector<image_source> const& sources);
+
+/// Drops pending decodes and joins the pool threads.
+void stop_image_prefetch();
+
+} } }
+
+#endif
@@ -18,48 +18,42 @@
 #define GHTV_OPENGL_LINUX_IMAGE_CONVERSION_HPP
 
 #include <vector>
+#include <cstddef>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
-/// @note The returned buffer has not padding bytes.
-inline void rgba_from_cairo_ARGB32(void* data, int width, int height, int stride, std::vector<unsigned char>& output)
+/// Whether every pixel of a RGBA image has alpha 255.
+inline bool rgba_opaque(unsigned char const* rgba, std::size_t pixels)
 {
-  const int line_size = 4 * width;
-  output.resize(line_size * height);
-  unsigned char* dest = &output[0];
-
-  unsigned char* src = (unsigned char*) data;
-  unsigned char* src_end = src + (height*stride);
-
-  // if 0x01 is the first byte the machine is little endian
-  long multibyte_integer = 1;
-  bool is_little_endian = ((char*)&multibyte_integer)[0] != 0;
-
-  while(src != src_end)
+  for(unsigned char const* alpha = rgba + 3, *last = rgba + 4*pixels
+        ; alpha < last; alpha += 4)
   {
-    for(unsigned char* px = src; px != src + line_size; px += 4)
-    {
-      // Cairo ARGB32:
-      // * little endian ..... BGRA
-      // * big endian ........ ARGB
-
-      // TODO Undo premultiplied alpha??
-      if(is_little_endian) {
-        *dest++ = px[2];
-        *dest++ = px[1];
-        *dest++ = px[0];
-        *dest++ = px[3];
-      } else {
-        *dest++ = px[1];
-        *dest++ = px[2];
-        *dest++ = px[3];
-        *dest++ = px[0];
-      }
-    }
-    src += stride;
+    if(*alpha != 0xFF)
+      return false;
   }
+  return true;
 }
 
+/// Converts a cairo ARGB32 surface, @p width x @p height pixels with
+/// rows @p stride bytes apart, to RGBA. Alpha stays premultiplied.
+///
+/// The channels are swizzled with SSSE3 pshufb, when the CPU has it, or
+/// NEON, a whole register of pixels at a time.
+/// @note The returned buffer has not padding bytes.
+void rgba_from_cairo_ARGB32(void* data, int width, int height, int stride, std::vector<unsigned char>& output);
+
+/// Same as @ref rgba_from_cairo_ARGB32, but also divides the colors by
+/// alpha, which is what the straight alpha blending of the player
+/// expects. Runs of opaque or fully transparent pixels only get swizzled.
+void unpremultiplied_rgba_from_cairo_ARGB32(void* data, int width, int height, int stride
+                                            , std::vector<unsigned char>& output);
+
+/// Un-premultiplies a cairo ARGB32 surface without reordering its
+/// channels, for textures that take BGRA pixels.
+/// @pre The machine is little endian, where ARGB32 is BGRA in memory.
+void unpremultiplied_bgra_from_cairo_ARGB32(void* data, int width, int height, int stride
+                                            , std::vector<unsigned char>& output);
+
 } } }
 
 #endif
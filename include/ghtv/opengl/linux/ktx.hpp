@@ -0,0 +1,66 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_KTX_HPP
+#define GHTV_OPENGL_LINUX_KTX_HPP
+
+#include <boost/cstdint.hpp>
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// GL internal formats of the ETC compressed textures, as stored in KTX
+/// files.
+boost::uint32_t const etc1_rgb8_format = 0x8D64;
+boost::uint32_t const etc2_rgb8_format = 0x9274;
+boost::uint32_t const etc2_rgba8_eac_format = 0x9278;
+
+/// The first mipmap level of a texture compressed in 4x4 pixel blocks.
+struct compressed_image
+{
+  compressed_image()
+    : format(0), width(0), height(0)
+  {}
+
+  /// The formats without alpha are drawn without blending
+  bool opaque() const { return format != etc2_rgba8_eac_format; }
+
+  boost::uint32_t format;
+  std::size_t width, height;
+  std::vector<unsigned char> data;
+};
+
+/// Bytes taken by a @p width x @p height image in @p format, 0 if it is
+/// not an ETC format.
+std::size_t compressed_size(boost::uint32_t format, std::size_t width, std::size_t height);
+
+/// Path of the KTX file that ktx-transcode writes next to @p image.
+std::string ktx_sidecar_path(std::string const& image);
+
+/// Parses the @p size bytes of a KTX file into @p image.
+/// @throw std::runtime_error if it is not a KTX file of an ETC format.
+void load_ktx(unsigned char const* bytes, std::size_t size, compressed_image& image);
+
+/// Writes @p image to @p path as a KTX file with one mipmap level.
+/// @throw std::runtime_error if the file cannot be written.
+void write_ktx(std::string const& path, compressed_image const& image);
+
+} } }
+
+#endif
@@ -17,24 +17,66 @@
 #ifndef LOAD_GIF_HPP
 #define LOAD_GIF_HPP
 
-#ifdef GHTV_USE_GLUT
-#include <GL/glut.h>
-#endif
-
-#ifdef GHTV_USE_OPENGLES2
-#include <GLES2/gl2.h>
-#include <GLES2/gl2ext.h>
-#endif
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
 
-#include <ghtv/opengl/texture.hpp>
-#include <ghtv/opengl/linux/binary_file.hpp>
 #include <vector>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
-void load_gif_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height);
+/// One image of a GIF, as decoded by giflib: palette indices of its
+/// rectangle of the logical screen.
+struct gif_frame
+{
+  int left, top, width, height;
+  /// How the rectangle is left before the next frame: 2 restores the
+  /// background, 3 what was under it; other values keep it.
+  int disposal;
+  unsigned int delay_ms;
+  std::vector<unsigned char> indices;
+  /// RGBA of every index, see @ref make_palette_lut. The transparent
+  /// index has alpha 0 and is not drawn.
+  std::vector<boost::uint32_t> colors;
+};
+
+/// Every frame of a GIF, decoded once.
+struct gif_frames
+{
+  std::size_t width, height;
+  std::vector<gif_frame> frames;
+  /// Every frame already composed to RGBA, if they fit in the budget
+  /// given to @ref load_gif_frames. Otherwise @ref gif_animation composes
+  /// them as it goes, which is cheap as no LZW decoding is involved.
+  std::vector<std::vector<unsigned char> > composed;
+
+  /// Bytes of indices, color tables and composed frames
+  std::size_t memory() const;
+};
+
+/// Decodes all frames of @p size bytes of GIF in memory, composing them
+/// ahead when all of them fit in @p composed_budget bytes of RGBA.
+/// @throw std::runtime_error if it could not be decoded.
+boost::shared_ptr<gif_frames const> load_gif_frames
+  (unsigned char const* bytes, std::size_t size, std::size_t composed_budget);
+
+/// Plays @ref gif_frames in a loop, on a canvas of its own.
+struct gif_animation
+{
+  explicit gif_animation(boost::shared_ptr<gif_frames const> const& frames);
+
+  /// RGBA of the current frame, of the logical screen size
+  unsigned char const* pixels() const;
+  /// How long the current frame is shown
+  unsigned int delay_ms() const;
+  void advance();
+  /// Bytes used by the frames and the canvas
+  std::size_t memory() const;
 
-texture load_gif(binary_file const& file);
+private:
+  boost::shared_ptr<gif_frames const> frames;
+  std::size_t current;
+  std::vector<unsigned char> canvas, saved;
+};
 
 } } }
 
@@ -17,24 +17,26 @@
 #ifndef LOAD_JPG_HPP
 #define LOAD_JPG_HPP
 
-#ifdef GHTV_USE_GLUT
-#include <GL/glut.h>
-#endif
-
-#ifdef GHTV_USE_OPENGLES2
-#include <GLES2/gl2.h>
-#include <GLES2/gl2ext.h>
-#endif
-
-#include <ghtv/opengl/texture.hpp>
 #include <ghtv/opengl/linux/binary_file.hpp>
 #include <vector>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
-void load_jpg_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height);
-
-texture load_jpg(binary_file const& file);
+/// Decodes at the smallest DCT scale whose size is at least
+/// @p min_width x @p min_height, or at full size if there is none.
+void load_jpg_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height
+                      , std::size_t min_width = 0, std::size_t min_height = 0);
+
+/// Same as above for @p size bytes of JPEG in memory, which are read in
+/// place. libjpeg writes the scan lines straight into @p data.
+void load_jpg_to_rgba(unsigned char const* bytes, std::size_t size, std::vector<unsigned char>& data
+                      , std::size_t& width, std::size_t& height
+                      , std::size_t min_width = 0, std::size_t min_height = 0);
+
+/// Turns the full @p width x @p height of a JPEG into the size the
+/// decoders above give for @p min_width x @p min_height.
+void jpg_scaled_size(std::size_t& width, std::size_t& height
+                     , std::size_t min_width, std::size_t min_height);
 
 } } }
 
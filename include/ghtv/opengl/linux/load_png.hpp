@@ -22,14 +22,15 @@
 #else
 
 #include <ghtv/opengl/linux/binary_file.hpp>
-#include <ghtv/opengl/texture.hpp>
 #include <vector>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
 void load_png_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height);
 
-texture load_png(binary_file const& file);
+/// Decodes @p size bytes of PNG in memory, with libpng writing the rows
+/// straight into @p data.
+void load_png_to_rgba(unsigned char const* bytes, std::size_t size, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height);
 
 } } }
 #endif
@@ -29,6 +29,7 @@
 #include <ghtv/opengl/player_base.hpp>
 #include <ghtv/opengl/linux/binary_file.hpp>
 #include <ghtv/opengl/linux/lua/event_handler.hpp>
+#include <ghtv/opengl/linux/texture_upload.hpp>
 #include <ghtv/opengl/texture.hpp>
 #include <luabind/object.hpp>
 #include <boost/thread.hpp>
@@ -156,6 +157,7 @@ public:
   std::size_t width;
   std::size_t height;
   ghtv::opengl::texture texture_;
+  texture_uploader uploader_;
 
   boost::atomic_bool dying;
 
@@ -0,0 +1,47 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_MAPPED_FILE_HPP
+#define GHTV_OPENGL_LINUX_MAPPED_FILE_HPP
+
+#include <string>
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// A whole file mapped read-only in memory, unmapped on destruction. The
+/// kernel is told it will be read soon and from start to end.
+struct mapped_file
+{
+  /// @throw std::runtime_error if the file cannot be opened or mapped.
+  explicit mapped_file(std::string const& path);
+  ~mapped_file();
+
+  /// Null for an empty file
+  unsigned char const* data() const { return address; }
+  std::size_t size() const { return length; }
+
+private:
+  unsigned char const* address;
+  std::size_t length;
+
+  mapped_file(mapped_file const&);
+  mapped_file& operator=(mapped_file const&);
+};
+
+} } }
+
+#endif
@@ -0,0 +1,39 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_NCL_IMAGES_HPP
+#define GHTV_OPENGL_LINUX_NCL_IMAGES_HPP
+
+#include <ghtv/opengl/linux/image_cache.hpp>
+
+#include <libxml/tree.h>
+
+#include <vector>
+#include <string>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Collects the sources of the image medias of the NCL document that can
+/// be started, following the ports and links from the body. Medias
+/// inside a switch are all collected, as any of them may be selected.
+/// The size of each is that of the region of its descriptor, on a
+/// @p screen_width x @p screen_height screen, or zero if it has none.
+void collect_image_sources(xmlDocPtr document, std::size_t screen_width, std::size_t screen_height
+                           , std::vector<image_source>& sources);
+
+} } }
+
+#endif
@@ -0,0 +1,49 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_PALETTE_EXPAND_HPP
+#define GHTV_OPENGL_LINUX_PALETTE_EXPAND_HPP
+
+#include <boost/cstdint.hpp>
+
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Number of entries of a palette lookup table, one per 8-bit index.
+std::size_t const palette_size = 256;
+
+/// Fills @p lut with the RGBA, in memory order, of the @p count RGB
+/// triplets of @p rgb. Entries past the palette and the @p transparent
+/// index, if not -1, get alpha 0.
+void make_palette_lut(unsigned char const* rgb, std::size_t count, int transparent
+                      , boost::uint32_t* lut);
+
+/// Writes the @p lut color of each of the @p count @p indices to @p rgba.
+void expand_palette(unsigned char const* indices, std::size_t count
+                    , boost::uint32_t const* lut, unsigned char* rgba);
+
+/// Same as @ref expand_palette, but leaves the pixels whose color has
+/// alpha 0 untouched, for frames drawn over others.
+void expand_palette_over(unsigned char const* indices, std::size_t count
+                         , boost::uint32_t const* lut, unsigned char* rgba);
+
+/// Sets @p count pixels of @p rgba to @p color.
+void fill_rgba(unsigned char* rgba, std::size_t count, boost::uint32_t color);
+
+} } }
+
+#endif
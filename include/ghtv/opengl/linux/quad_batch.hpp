@@ -0,0 +1,86 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_QUAD_BATCH_HPP
+#define GHTV_OPENGL_LINUX_QUAD_BATCH_HPP
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#endif
+
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/linux/shader_variants.hpp>
+
+#include <vector>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Vertex attribute locations bound by load_shader_variants before linking.
+enum quad_attribute
+{
+  position_attribute = 0
+  , texture_coord_attribute = 1
+  , zindex_attribute = 2
+  , clip_attribute = 3
+  , border_color_attribute = 4
+  , uv_rect_attribute = 5
+};
+
+/// Accumulates the quads of a frame in one interleaved vertex array and
+/// draws every run of consecutive quads sharing a texture and a shader
+/// variant with a single glDrawElements. Depth, clip and border color are
+/// vertex attributes, so no uniform changes between quads.
+///
+/// The vertex and index buffers are created on the first @ref flush and
+/// reused by every frame afterwards.
+struct quad_batch
+{
+  quad_batch();
+
+  /// @param depth In (0, 1), quads with a greater depth are in front.
+  void add(draw_record const& record, GLfloat depth);
+  /// Uploads the accumulated vertices and issues the draw calls.
+  void flush();
+
+  /// Draw calls issued since construction
+  std::size_t draw_calls() const { return total_draw_calls; }
+
+private:
+  struct run
+  {
+    shader_variant variant;
+    opengl::texture* texture;
+    GLuint texture_id;
+    std::size_t quads;
+  };
+
+  void create_buffers();
+
+  std::vector<GLfloat> vertices;
+  std::vector<run> runs;
+  std::size_t quads;
+
+  GLuint vertex_buffer, index_buffer;
+  std::size_t vertex_buffer_size;
+  std::size_t total_draw_calls;
+};
+
+} } }
+
+#endif
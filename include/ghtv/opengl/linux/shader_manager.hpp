@@ -0,0 +1,52 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_SHADER_MANAGER_HPP
+#define GHTV_OPENGL_LINUX_SHADER_MANAGER_HPP
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#endif
+
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+struct shader_attribute
+{
+  GLuint location;
+  char const* name;
+};
+
+/// Returns a linked program made of the two shaders, with the attributes
+/// bound to the given locations.
+///
+/// Linked programs are persisted with GL_OES_get_program_binary (or
+/// glGetProgramBinary on OpenGL ES 3 and desktop OpenGL) under
+/// $XDG_CACHE_HOME/ghtv-opengl-player, keyed by a hash of the GL vendor,
+/// renderer and version, the sources and the attribute locations. A cached
+/// binary is used when present and accepted by the driver; otherwise the
+/// shaders are compiled and the result cached for the next start.
+/// Throws std::runtime_error if compiling or linking fails.
+GLuint load_program(char const* vertex_source, char const* fragment_source
+                    , shader_attribute const* attributes, std::size_t attribute_count);
+
+} } }
+
+#endif
@@ -0,0 +1,55 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_SHADER_VARIANTS_HPP
+#define GHTV_OPENGL_LINUX_SHADER_VARIANTS_HPP
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#endif
+
+#include <ghtv/opengl/linux/compositor.hpp>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Programs specialized from one fragment shader source, so that the
+/// common case of a quad with no clip and no border samples its texture
+/// without testing anything per fragment.
+enum shader_variant
+{
+  plain_variant          ///< Texture only
+  , clipped_variant      ///< Texture, transparent outside the clip rectangle
+  , bordered_variant     ///< Clipped texture surrounded by a solid border
+  , solid_variant        ///< Border color only, for quads without a texture
+  , shader_variant_count
+};
+
+/// Compiles, or loads from the program binary cache, every variant and
+/// sets their projection matrix and sampler uniforms.
+void load_shader_variants(GLfloat const* projection_matrix);
+
+/// Cheapest variant that draws @p record correctly.
+shader_variant select_shader_variant(draw_record const& record);
+
+/// Makes @p variant the current program, if it is not already.
+void use_shader_variant(shader_variant variant);
+
+} } }
+
+#endif
@@ -0,0 +1,45 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_STATIC_IMAGE_HPP
+#define GHTV_OPENGL_LINUX_STATIC_IMAGE_HPP
+
+#include <ghtv/opengl/linux/texture_atlas.hpp>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// What is known about an image decoded in software and uploaded once.
+/// Players showing one derive from it so the display list can find it.
+struct static_image
+{
+  static_image()
+    : region(), opaque(false)
+  {}
+  virtual ~static_image() { atlas_release(region); }
+
+  /// Where the image is, if it was packed in an atlas page. Released on
+  /// destruction.
+  atlas_region region;
+  /// Every pixel has alpha 1, so the image can be drawn without blending
+  bool opaque;
+private:
+  static_image(static_image const&);
+  static_image& operator=(static_image const&);
+};
+
+} } }
+
+#endif
@@ -25,20 +25,50 @@
 #include <ghtv/opengl/linux/sound_player.hpp>
 #include <ghtv/opengl/linux/html_player.hpp>
 #include <ghtv/opengl/linux/text_player.hpp>
+#include <ghtv/opengl/linux/idle_update.hpp>
+#include <ghtv/opengl/linux/display_list.hpp>
+#include <ghtv/opengl/linux/static_image.hpp>
+#include <ghtv/opengl/linux/image_cache.hpp>
+#include <ghtv/opengl/linux/animation.hpp>
+#include <ghtv/opengl/linux/texture_upload.hpp>
+#include <ghtv/opengl/linux/clock.hpp>
 
 #include <ghtv/opengl/player_base.hpp>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
-struct static_texture_player : ghtv::opengl::player_base
+// Uploads @p image into an atlas page when it is small enough. Compressed
+// images always get a texture of their own, since pages are RGBA.
+inline opengl::texture load_image_texture(decoded_image const& image, atlas_region& region)
+{
+  if(!image.compressed)
+    return load_rgba_texture(image.pixels(), image.width, image.height, region);
+
+  opengl::texture texture;
+  region = atlas_region();
+  upload_compressed_texture(texture, *image.compressed);
+  return texture;
+}
+
+struct static_texture_player : ghtv::opengl::player_base, static_image
 {
   static_texture_player(ghtv::opengl::texture t)
     : texture_(t)
   {
   }
 
+  // Uploads an image decoded in software, see load_image_texture
+  static_texture_player(decoded_image const& image)
+    : texture_(load_image_texture(image, region))
+  {
+    opaque = image.opaque;
+  }
+
 
   bool has_texture() const { return true; }
 
@@ -63,10 +93,11 @@ struct static_texture_player : ghtv::opengl::player_base
   ghtv::opengl::texture texture_;
 };
 
-struct async_static_texture_player : ghtv::opengl::player_base
+// Shows nothing until its image is decoded and uploaded
+struct async_static_texture_player : ghtv::opengl::player_base, static_image
 {
-  async_static_texture_player()
-    : busy(true)
+  async_static_texture_player(gntl::algorithm::structure::media::dimensions dim)
+    : dim(dim), ready(false), busy(false)
   {
   }
   ~async_static_texture_player()
@@ -82,6 +113,7 @@ struct async_static_texture_player : ghtv::opengl::player_base
   {
     texture_ = t;
     texture_.good = true; // TODO Is it right?
+    ready = true;
 
     boost::unique_lock<boost::mutex> l(global_state.pipeline_mutex);
     busy = false;
@@ -89,11 +121,25 @@ struct async_static_texture_player : ghtv::opengl::player_base
     global_state.reset_image_pipelines.push_back(*pipeline);
     global_state.busy_image_pipelines.erase(pipeline);
     global_state.pipeline_condition.notify_all();
+    l.unlock();
+
+    request_texture_refresh(this);
+    async_redraw();
   }
 #endif
 
+  // Called on the render thread once the software decoder is done
+  virtual void image_ready(decoded_image const& image)
+  {
+    texture_ = load_image_texture(image, region);
+    texture_.set_width(dim.width);
+    texture_.set_height(dim.height);
+    opaque = image.opaque;
+    ready = true;
+    request_texture_refresh(this);
+  }
 
-  bool has_texture() const { return true; }
+  bool has_texture() const { return ready; }
 
   void get_textures(ghtv::opengl::texture*& textures, unsigned& size)
   {
@@ -114,8 +160,80 @@ struct async_static_texture_player : ghtv::opengl::player_base
   bool want_keys() const { return false; }
 
   ghtv::opengl::texture texture_;
+  gntl::algorithm::structure::media::dimensions dim;
+  bool ready;
   bool busy;
 };
+
+// Plays an animated GIF from its decoded frames, advanced by draw() when
+// each frame is due. A GIF of a single image is shown as any other.
+struct gif_player : async_static_texture_player, animation
+{
+  gif_player(gntl::algorithm::structure::media::dimensions dim, std::string const& source)
+    : async_static_texture_player(dim), source(source)
+    , frame_width(0), frame_height(0), next_frame(0)
+  {
+  }
+  ~gif_player()
+  {
+    if(gif)
+      unregister_animation(this);
+  }
+
+  void image_ready(decoded_image const& image)
+  {
+    if(!image.frames)
+    {
+      async_static_texture_player::image_ready(image);
+      return;
+    }
+
+    gif.reset(new gif_animation(image.frames));
+    frame_width = image.width;
+    frame_height = image.height;
+    uploader.upload(texture_, gif->pixels(), frame_width, frame_height);
+    texture_.set_width(dim.width);
+    texture_.set_height(dim.height);
+    ready = true;
+    std::cout << "GIF animation " << source << ": " << image.frames->frames.size()
+              << " frames, " << gif->memory() / 1024 << " KiB" << std::endl;
+
+    next_frame = monotonic_microseconds() + 1000 * boost::int64_t(gif->delay_ms());
+    register_animation(this);
+    request_texture_refresh(this);
+  }
+
+  boost::int64_t animate(boost::int64_t now)
+  {
+    if(now < next_frame)
+      return next_frame;
+
+    gif->advance();
+    uploader.upload(texture_, gif->pixels(), frame_width, frame_height);
+    request_texture_refresh(this);
+
+    boost::int64_t const delay = 1000 * boost::int64_t(gif->delay_ms());
+    next_frame += delay;
+    // After a stall the animation resumes from now instead of catching up
+    if(next_frame <= now)
+      next_frame = now + delay;
+    return next_frame;
+  }
+
+  std::string source;
+  boost::scoped_ptr<gif_animation> gif;
+  texture_uploader uploader;
+  std::size_t frame_width, frame_height;
+  boost::int64_t next_frame;
+};
+
+inline void deliver_async_image(boost::weak_ptr<ghtv::opengl::player_base> const& player
+                                , boost::shared_ptr<decoded_image const> const& image)
+{
+  // The media may have stopped while its image was being decoded
+  if(boost::shared_ptr<ghtv::opengl::player_base> p = player.lock())
+    static_cast<async_static_texture_player*>(p.get())->image_ready(*image);
+}
       
 inline
 player_factory::result_type player_factory::operator()
@@ -161,43 +279,51 @@ player_factory::result_type player_factory::operator()
     );
   }
 
-  if(boost::algorithm::iends_with(source_str, ".gif"))
-  {
-    ghtv::opengl::texture texture = load_gif(file);
-    texture.set_width(dim.width);
-    texture.set_height(dim.height);
-    return result_type(
-      new ghtv::opengl::linux_::static_texture_player(texture)
-    );
-  }
-
-#ifndef GHTV_USE_OPENMAX
-  ghtv::opengl::texture texture;
-  if(boost::algorithm::iends_with(source_str, ".png"))
-  {
-    texture = load_png(file);
-  }
-  else if(boost::algorithm::iends_with(source_str, ".jpeg") || boost::algorithm::iends_with(source_str, ".jpg"))
-  {
-    texture = load_jpg(file);
-  }
-  else
-  {
-    throw std::runtime_error("File type not supported: " + source_str);
-  }
-  texture.set_width(dim.width);
-  texture.set_height(dim.height);
-#endif
-
-  result_type p(new ghtv::opengl::linux_
 #ifndef GHTV_USE_OPENMAX
-                ::static_texture_player(texture)
+  bool const software_decode = true;
 #else
-                ::async_static_texture_player
+  bool const software_decode = boost::algorithm::iends_with(source_str, ".gif");
 #endif
-                );
+  if(software_decode)
+  {
+    // Decoded no larger than needed to fill the region
+    std::size_t const min_width = dim.width > 0 ? dim.width : 0;
+    std::size_t const min_height = dim.height > 0 ? dim.height : 0;
+    boost::shared_ptr<decoded_image const> image
+      = find_cached_image(file, min_width, min_height, true);
+    bool const gif = boost::algorithm::iends_with(source_str, ".gif");
+    if(!image)
+    {
+      // Decoding would stall events and rendering, the player appears
+      // once its image is ready
+      result_type p(gif ? new ghtv::opengl::linux_::gif_player(dim, source_str)
+                    : new ghtv::opengl::linux_::async_static_texture_player(dim));
+      decode_image_async(file, min_width, min_height, boost::bind(&deliver_async_image
+                                           , boost::weak_ptr<ghtv::opengl::player_base>(p), _1));
+      return p;
+    }
+    if(image->frames)
+    {
+      ghtv::opengl::linux_::gif_player* player
+        = new ghtv::opengl::linux_::gif_player(dim, source_str);
+      result_type p(player);
+      player->image_ready(*image);
+      return p;
+    }
+
+    ghtv::opengl::linux_::static_texture_player* player
+      = new ghtv::opengl::linux_::static_texture_player(*image);
+    result_type p(player);
+    player->texture_.set_width(dim.width);
+    player->texture_.set_height(dim.height);
+    return p;
+  }
 
 #ifdef GHTV_USE_OPENMAX
+  result_type p(new ghtv::opengl::linux_::async_static_texture_player(dim));
+  // Until the pipeline hands the texture back
+  static_cast<async_static_texture_player*>(p.get())->busy = true;
+
   if(boost::algorithm::iends_with(source_str, ".png"))
   {
     ghtv::opengl::linux_::load_png
@@ -208,8 +334,8 @@ player_factory::result_type player_factory::operator()
   {
     throw std::runtime_error("File type not supported: " + source_str);
   }
-#endif  
   return p;
+#endif
 }
       
 } } }
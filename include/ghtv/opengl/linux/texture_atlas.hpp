@@ -0,0 +1,77 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_TEXTURE_ATLAS_HPP
+#define GHTV_OPENGL_LINUX_TEXTURE_ATLAS_HPP
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#endif
+
+#include <ghtv/opengl/texture.hpp>
+
+#include <ostream>
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Part of an atlas page holding one image.
+struct atlas_region
+{
+  atlas_region()
+    : page(-1), x(0), y(0), width(0), height(0)
+  {
+    uv[0] = uv[1] = 0.0f;
+    uv[2] = uv[3] = 1.0f;
+  }
+
+  bool valid() const { return page >= 0; }
+
+  int page;
+  int x, y, width, height;
+  /// Texture coordinates of the top-left and bottom-right corners
+  GLfloat uv[4];
+};
+
+/// Images with both dimensions up to this size are packed into atlas pages
+std::size_t const atlas_max_image_size = 256;
+
+/// Copies a @p width x @p height RGBA image into a shared atlas page using
+/// shelf packing. On success @p page_texture refers to the page's GL texture
+/// and @p region to the image inside it. Returns false if the image is too
+/// big for the atlas.
+bool atlas_insert(unsigned char const* rgba, std::size_t width, std::size_t height
+                  , opengl::texture& page_texture, atlas_region& region);
+
+/// Uploads a RGBA image, into an atlas page when it is small enough and
+/// into a texture of its own otherwise, in which case @p region is left
+/// invalid.
+opengl::texture load_rgba_texture(unsigned char const* rgba, std::size_t width, std::size_t height
+                                  , atlas_region& region);
+
+/// Gives back the area used by @p region. Pages are reused when all their
+/// regions are released.
+void atlas_release(atlas_region const& region);
+
+/// Prints occupancy and fragmentation of every page.
+void print_atlas_statistics(std::ostream& os);
+
+} } }
+
+#endif
@@ -0,0 +1,98 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHTV_OPENGL_LINUX_TEXTURE_UPLOAD_HPP
+#define GHTV_OPENGL_LINUX_TEXTURE_UPLOAD_HPP
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#endif
+
+#include <ghtv/opengl/texture.hpp>
+#include <ghtv/opengl/linux/ktx.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <vector>
+#include <cstddef>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+/// Memory order of the channels of the pixels given to the uploads.
+enum pixel_format
+{
+  rgba_pixels
+  , bgra_pixels
+};
+
+/// Whether textures can be uploaded from @ref bgra_pixels: desktop OpenGL
+/// 1.2, or OpenGL ES with GL_EXT_texture_format_BGRA8888. Also requires a
+/// little endian machine, where cairo ARGB32 surfaces are BGRA in memory,
+/// since those are what skip the conversion.
+bool bgra_upload_supported();
+
+/// Allocates the storage of @p texture for a @p width x @p height RGBA
+/// image and fills it with @p rgba, which may be null to leave it
+/// undefined. Sets nearest filtering.
+///
+/// @p format must be @ref rgba_pixels unless @ref bgra_upload_supported.
+void upload_texture(opengl::texture& texture, unsigned char const* rgba
+                    , std::size_t width, std::size_t height
+                    , pixel_format format = rgba_pixels);
+
+/// The ETC formats textures can be created from: ETC1 with
+/// GL_OES_compressed_ETC1_RGB8_texture, every one of them with OpenGL ES 3
+/// or GL_ARB_ES3_compatibility, since ETC2 decodes ETC1 blocks.
+std::vector<boost::uint32_t> supported_compressed_formats();
+
+/// Allocates the storage of @p texture from a compressed @p image, whose
+/// format must be one of @ref supported_compressed_formats. Sets nearest
+/// filtering.
+void upload_compressed_texture(opengl::texture& texture, compressed_image const& image);
+
+/// Replaces a region of the already allocated storage of @p texture.
+///
+/// Where GL_PIXEL_UNPACK_BUFFER exists (OpenGL ES 3, desktop OpenGL 2.1)
+/// the pixels are copied into a ring of pixel buffer objects, so the
+/// transfer to the texture overlaps rendering instead of stalling it.
+void update_texture(opengl::texture& texture, int x, int y
+                    , std::size_t width, std::size_t height, unsigned char const* rgba
+                    , pixel_format format = rgba_pixels);
+
+/// Uploads the successive contents of a texture that changes often, like
+/// a canvas. Storage is only reallocated when the texture, its size or
+/// its pixel format change; otherwise the image goes through
+/// @ref update_texture.
+struct texture_uploader
+{
+  texture_uploader();
+
+  void upload(opengl::texture& texture, unsigned char const* rgba
+              , std::size_t width, std::size_t height
+              , pixel_format format = rgba_pixels);
+
+private:
+  GLuint texture_id;
+  std::size_t width, height;
+  pixel_format format;
+};
+
+} } }
+
+#endif
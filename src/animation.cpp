@@ -0,0 +1,53 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/animation.hpp>
+
+#include <vector>
+#include <algorithm>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+std::vector<animation*> animations;
+
+}
+
+void register_animation(animation* a)
+{
+  animations.push_back(a);
+}
+
+void unregister_animation(animation* a)
+{
+  animations.erase(std::remove(animations.begin(), animations.end(), a), animations.end());
+}
+
+boost::int64_t run_animations(boost::int64_t now)
+{
+  boost::int64_t next = 0;
+  for(std::vector<animation*>::const_iterator first = animations.begin()
+        , last = animations.end(); first != last; ++first)
+  {
+    boost::int64_t const time = (*first)->animate(now);
+    if(!next || time < next)
+      next = time;
+  }
+  return next;
+}
+
+} } }
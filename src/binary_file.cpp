@@ -17,9 +17,11 @@
 #include <ghtv/opengl/linux/binary_file.hpp>
 
 #include <ghtv/opengl/linux/url_join.hpp>
+#include <ghtv/opengl/linux/mapped_file.hpp>
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/shared_ptr.hpp>
 
 // #define CURL_STATICLIB
 #include <curl/curl.h>
@@ -27,24 +29,51 @@
 
 #include <stdexcept>
 #include <sstream>
-#include <fstream>
+#include <vector>
 #include <cassert>
 
+#include <unistd.h>
+
 namespace ghtv { namespace opengl { namespace linux_ {
 
 namespace {
 
 bool libcurl_initialized = false;
 
+typedef size_t (*write_function)(void *contents, size_t size, size_t nmemb, void *userp);
+
 size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp)
 {
-  // TODO: Use stream object instead of vector??
-  binary_file::content* vec = (binary_file::content*) userp;
+  std::vector<char>* vec = (std::vector<char>*) userp;
   char* c = (char*) contents;
   vec->insert(vec->end(), c, c + (size*nmemb));
   return size * nmemb;
 }
 
+struct stream_state
+{
+  content_sink* sink;
+  bool failed;
+  std::string error;
+};
+
+size_t stream_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+  stream_state* state = (stream_state*) userp;
+  // Exceptions must not cross libcurl, a short count aborts the transfer
+  try
+  {
+    state->sink->consume((unsigned char const*) contents, size * nmemb);
+  }
+  catch(std::exception const& e)
+  {
+    state->failed = true;
+    state->error = e.what();
+    return 0;
+  }
+  return size * nmemb;
+}
+
 } // end of anonymous namespace
 
 struct binary_file::binary_file_impl
@@ -209,22 +238,18 @@ struct binary_file::binary_file_impl
   {
     switch(type)
     {
-    case POSIX_PATH: load_local_file_data(); break;
+    case POSIX_PATH: load_local_file_data(add_leading_null); break;
     case FILE_URL:
-    case GENERIC_URL: load_url_data(); break;
+    case GENERIC_URL: load_url_data(add_leading_null); break;
     default:
       throw std::runtime_error("Unknown file source: " + uri);
     }
-
-    if(add_leading_null) {
-      file_content.push_back('\0');
-    }
   }
 
   void release_content()
   {
-    // Force memory release
-    content().swap(file_content);
+    // Freed with the last copy sharing it
+    file_content = content();
   }
 
   std::string url() const
@@ -243,8 +268,41 @@ struct binary_file::binary_file_impl
     return uri;
   }
 
+  void stream_url_data(content_sink& sink) const
+  {
+    stream_state state;
+    state.sink = &sink;
+    state.failed = false;
+    try
+    {
+      perform_url_request(stream_callback, &state);
+    }
+    catch(std::runtime_error const&)
+    {
+      // The sink aborted the transfer, its error tells why
+      if(state.failed)
+        throw std::runtime_error(state.error);
+      throw;
+    }
+  }
+
 private:
-  void load_url_data()
+  void load_url_data(bool add_leading_null)
+  {
+    boost::shared_ptr<std::vector<char> > buffer(new std::vector<char>);
+    perform_url_request(write_callback, buffer.get());
+    set_content(buffer, add_leading_null);
+  }
+
+  void set_content(boost::shared_ptr<std::vector<char> > const& buffer, bool add_leading_null)
+  {
+    if(add_leading_null) {
+      buffer->push_back('\0');
+    }
+    file_content = content(buffer, buffer->empty() ? 0 : &(*buffer)[0], buffer->size());
+  }
+
+  void perform_url_request(write_function callback, void* data) const
   {
     CURL* curl = curl_easy_init();
     if(!curl) {
@@ -252,8 +310,8 @@ private:
     }
 
     curl_easy_setopt(curl, CURLOPT_URL, uri.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &file_content);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, data);
 
     CURLcode res = curl_easy_perform(curl);
     curl_easy_cleanup(curl); // Free memory
@@ -265,22 +323,20 @@ private:
     }
   }
 
-  void load_local_file_data()
+  void load_local_file_data(bool add_leading_null)
   {
-    std::ifstream file(uri.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
-    if(!file.is_open())
+    boost::shared_ptr<mapped_file const> mapped(new mapped_file(uri));
+    char const* const data = reinterpret_cast<char const*>(mapped->data());
+    std::size_t const size = mapped->size();
+    // The rest of the last page of a mapping reads as zeros, a file
+    // that ends within a page is terminated already
+    static std::size_t const page_size = ::sysconf(_SC_PAGESIZE);
+    if(!add_leading_null || size % page_size != 0)
     {
-      throw std::runtime_error("Could not open: " + uri);
-    }
-    long fsize = file.tellg();
-    file.seekg(0);
-    file_content.resize(fsize);
-    file.read(&file_content[0], fsize);
-    if(!file.good())
-    {
-      release_content();
-      throw std::runtime_error("Could not read: " + uri);
+      file_content = content(mapped, data, size + (add_leading_null ? 1 : 0));
+      return;
     }
+    set_content(boost::shared_ptr<std::vector<char> >(new std::vector<char>(data, data + size)), true);
   }
 
 public:
@@ -339,6 +395,17 @@ void binary_file::release_content()
   impl->release_content();
 }
 
+void binary_file::stream_content(content_sink& sink) const
+{
+  if(!is_local() && impl->file_content.empty())
+  {
+    impl->stream_url_data(sink);
+    return;
+  }
+  file_bytes bytes(*this);
+  sink.consume(bytes.data(), bytes.size());
+}
+
 binary_file::content const& binary_file::file_content() const
 {
   return impl->file_content;
@@ -346,7 +413,7 @@ binary_file::content const& binary_file::file_content() const
 
 const char* binary_file::file_content_p() const
 {
-  return &(impl->file_content.front());
+  return impl->file_content.data();
 }
 
 bool binary_file::is_local() const
@@ -374,6 +441,27 @@ std::string const& binary_file::file_posix_path() const
   return impl->file_posix_path();
 }
 
+file_bytes::file_bytes(binary_file const& file)
+  : content(file.file_content())
+{
+  if(content.empty())
+  {
+    binary_file loaded(file);
+    loaded.load_content();
+    content = loaded.file_content();
+  }
+}
+
+unsigned char const* file_bytes::data() const
+{
+  return reinterpret_cast<unsigned char const*>(content.data());
+}
+
+std::size_t file_bytes::size() const
+{
+  return content.size();
+}
+
 void binary_file::initialize_binary_files()
 {
   if(libcurl_initialized) {
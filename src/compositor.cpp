@@ -0,0 +1,343 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#endif
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/linux/global_state.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <deque>
+#include <string>
+#include <iostream>
+
+#ifndef EGL_BUFFER_AGE_EXT
+#define EGL_BUFFER_AGE_EXT 0x313D
+#endif
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+typedef EGLBoolean (*set_damage_region_function)(EGLDisplay, EGLSurface, EGLint*, EGLint);
+typedef EGLBoolean (*swap_buffers_with_damage_function)(EGLDisplay, EGLSurface, EGLint const*, EGLint);
+
+// Number of previous frames whose damage is remembered for buffer age
+std::size_t const damage_history_size = 3;
+
+struct compositor_state
+{
+  compositor_state()
+    : initialized(false), full_damage(true)
+    , has_buffer_age(false), set_damage_region(0), swap_buffers_with_damage(0)
+  {}
+
+  bool initialized;
+  bool full_damage;
+  std::vector<draw_record> previous_records;
+  std::vector<opengl::texture const*> updated_textures;
+  std::deque<screen_rect> damage_history;
+  std::vector<screen_rect> occluders;
+
+  bool has_buffer_age;
+  set_damage_region_function set_damage_region;
+  swap_buffers_with_damage_function swap_buffers_with_damage;
+};
+
+compositor_state compositor;
+
+screen_rect screen()
+{
+  return screen_rect(0, 0, global_state.width, global_state.height);
+}
+
+bool texture_less(draw_record const& lhs, draw_record const& rhs)
+{
+  return lhs.texture < rhs.texture;
+}
+
+#ifndef GHTV_USE_GLUT
+void initialize_extensions()
+{
+  char const* extensions = eglQueryString(global_state.egl_display, EGL_EXTENSIONS);
+  std::string extensions_str = extensions ? (" " + std::string(extensions) + " ") : "";
+
+  compositor.has_buffer_age
+    = boost::algorithm::contains(extensions_str, " EGL_EXT_buffer_age ")
+    || boost::algorithm::contains(extensions_str, " EGL_KHR_partial_update ");
+  if(boost::algorithm::contains(extensions_str, " EGL_KHR_partial_update "))
+    compositor.set_damage_region = (set_damage_region_function)
+      eglGetProcAddress("eglSetDamageRegionKHR");
+  if(boost::algorithm::contains(extensions_str, " EGL_KHR_swap_buffers_with_damage "))
+    compositor.swap_buffers_with_damage = (swap_buffers_with_damage_function)
+      eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+  else if(boost::algorithm::contains(extensions_str, " EGL_EXT_swap_buffers_with_damage "))
+    compositor.swap_buffers_with_damage = (swap_buffers_with_damage_function)
+      eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+
+  std::cout << "compositor: buffer age " << (compositor.has_buffer_age ? "yes" : "no")
+            << ", partial update " << (compositor.set_damage_region ? "yes" : "no")
+            << ", swap with damage " << (compositor.swap_buffers_with_damage ? "yes" : "no")
+            << std::endl;
+}
+
+// EGL rectangles have their origin at the bottom-left corner
+void to_egl_rect(screen_rect const& r, EGLint* egl_rect)
+{
+  egl_rect[0] = r.left;
+  egl_rect[1] = global_state.height - r.bottom;
+  egl_rect[2] = r.right - r.left;
+  egl_rect[3] = r.bottom - r.top;
+}
+#endif
+
+}
+
+draw_record make_draw_record(opengl::texture& texture, int x, int y, int zindex)
+{
+  draw_record r;
+  r.player = 0;
+  r.texture = &texture;
+  r.texture_id = texture.raw();
+  r.zindex = zindex;
+  r.x = x + texture.x;
+  r.y = y + texture.y;
+  r.width = texture.width;
+  r.height = texture.height;
+  r.border_size = texture.border_size;
+  r.border_color[0] = texture.border_color.r;
+  r.border_color[1] = texture.border_color.g;
+  r.border_color[2] = texture.border_color.b;
+  r.clip[0] = texture.clip.left;
+  r.clip[1] = texture.clip.top;
+  r.clip[2] = texture.clip.right;
+  r.clip[3] = texture.clip.bottom;
+  r.uv[0] = r.uv[1] = 0.0f;
+  r.uv[2] = r.uv[3] = 1.0f;
+  r.opaque = false;
+  r.bounds = screen_rect(r.x - r.border_size, r.y - r.border_size
+                         , r.x + r.width + r.border_size, r.y + r.height + r.border_size);
+  return r;
+}
+
+bool is_clipped(draw_record const& record)
+{
+  return record.clip[0] > 0 || record.clip[1] > 0
+    || record.clip[2] < record.width || record.clip[3] < record.height;
+}
+
+bool draws_opaque(draw_record const& record)
+{
+  // Borders are opaque too, only the clip makes holes
+  return record.texture_id && record.opaque && !is_clipped(record);
+}
+
+std::size_t cull_records(std::vector<draw_record> const& records, screen_rect const& repaint
+                         , std::vector<std::size_t>& visible, std::size_t& undamaged)
+{
+  visible.clear();
+  compositor.occluders.clear();
+  undamaged = 0;
+
+  // Front to back, so every occluder found is in front of what follows
+  for(std::size_t i = records.size(); i-- != 0;)
+  {
+    screen_rect const bounds = records[i].bounds.intersection(repaint);
+    if(bounds.empty())
+    {
+      if(!records[i].bounds.intersection(screen()).empty())
+        ++undamaged;
+      continue;
+    }
+
+    bool occluded = false;
+    for(std::vector<screen_rect>::const_iterator first = compositor.occluders.begin()
+          , last = compositor.occluders.end(); !occluded && first != last; ++first)
+      occluded = first->intersection(bounds) == bounds;
+    if(occluded)
+      continue;
+
+    visible.push_back(i);
+    if(draws_opaque(records[i]))
+      compositor.occluders.push_back(bounds);
+  }
+  std::reverse(visible.begin(), visible.end());
+  return records.size() - visible.size() - undamaged;
+}
+
+void note_texture_update(opengl::texture const& texture)
+{
+  compositor.updated_textures.push_back(&texture);
+}
+
+void damage_screen()
+{
+  compositor.full_damage = true;
+}
+
+screen_rect compute_damage(std::vector<draw_record> const& records, bool records_changed)
+{
+  if(!records_changed && compositor.updated_textures.empty())
+  {
+    if(!compositor.full_damage)
+      return screen_rect();
+    compositor.full_damage = false;
+    return screen();
+  }
+
+  std::sort(compositor.updated_textures.begin(), compositor.updated_textures.end());
+  screen_rect damage;
+  if(!records_changed)
+  {
+    // Same records as last frame, only the updated textures are repainted
+    for(std::vector<draw_record>::const_iterator first = records.begin(), last = records.end()
+          ; first != last; ++first)
+    {
+      if(std::binary_search(compositor.updated_textures.begin()
+                            , compositor.updated_textures.end(), first->texture))
+        damage.merge(first->bounds);
+    }
+    compositor.updated_textures.clear();
+    if(compositor.full_damage)
+    {
+      compositor.full_damage = false;
+      return screen();
+    }
+    return damage.intersection(screen());
+  }
+
+  std::vector<draw_record> current(records);
+  std::stable_sort(current.begin(), current.end(), &texture_less);
+
+  std::vector<draw_record>::const_iterator
+    old_it = compositor.previous_records.begin()
+    , old_last = compositor.previous_records.end()
+    , new_it = current.begin()
+    , new_last = current.end();
+  while(old_it != old_last || new_it != new_last)
+  {
+    if(new_it == new_last || (old_it != old_last && old_it->texture < new_it->texture))
+    {
+      damage.merge(old_it++->bounds);
+    }
+    else if(old_it == old_last || new_it->texture < old_it->texture)
+    {
+      damage.merge(new_it++->bounds);
+    }
+    else
+    {
+      if(!old_it->same_contents(*new_it))
+      {
+        damage.merge(old_it->bounds);
+        damage.merge(new_it->bounds);
+      }
+      else if(std::binary_search(compositor.updated_textures.begin()
+                                 , compositor.updated_textures.end(), new_it->texture))
+      {
+        damage.merge(new_it->bounds);
+      }
+      ++old_it;
+      ++new_it;
+    }
+  }
+
+  compositor.previous_records.swap(current);
+  compositor.updated_textures.clear();
+
+  if(compositor.full_damage)
+  {
+    compositor.full_damage = false;
+    return screen();
+  }
+  return damage.intersection(screen());
+}
+
+screen_rect begin_frame(screen_rect const& damage)
+{
+  screen_rect repaint = screen();
+#ifndef GHTV_USE_GLUT
+  if(!compositor.initialized)
+  {
+    compositor.initialized = true;
+    initialize_extensions();
+  }
+
+  if(compositor.has_buffer_age)
+  {
+    EGLint age = 0;
+    if(!eglQuerySurface(global_state.egl_display, global_state.egl_surface
+                        , EGL_BUFFER_AGE_EXT, &age))
+      age = 0;
+    // Age 0 means undefined contents. Age N means the buffer holds the frame
+    // from N swaps ago, so the damage of the N-1 frames in between is added.
+    if(age > 0 && std::size_t(age) <= compositor.damage_history.size() + 1)
+    {
+      repaint = damage;
+      for(std::size_t i = 0; i + 1 < std::size_t(age); ++i)
+        repaint.merge(compositor.damage_history[i]);
+    }
+  }
+
+  compositor.damage_history.push_front(damage);
+  if(compositor.damage_history.size() > damage_history_size)
+    compositor.damage_history.pop_back();
+
+  if(compositor.set_damage_region && repaint != screen())
+  {
+    EGLint rect[4];
+    to_egl_rect(repaint, rect);
+    compositor.set_damage_region(global_state.egl_display, global_state.egl_surface, rect, 1);
+  }
+#endif
+
+  if(repaint != screen())
+  {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(repaint.left, global_state.height - repaint.bottom
+              , repaint.right - repaint.left, repaint.bottom - repaint.top);
+  }
+  return repaint;
+}
+
+void end_frame(screen_rect const& damage)
+{
+  glDisable(GL_SCISSOR_TEST);
+#if defined(GHTV_USE_GLUT)
+  glutSwapBuffers();
+#else
+  if(compositor.swap_buffers_with_damage && damage != screen())
+  {
+    EGLint rect[4];
+    to_egl_rect(damage, rect);
+    compositor.swap_buffers_with_damage(global_state.egl_display, global_state.egl_surface, rect, 1);
+  }
+  else if(global_state.egl_surface != EGL_NO_SURFACE)
+    eglSwapBuffers(global_state.egl_display, global_state.egl_surface);
+#endif
+}
+
+} } }
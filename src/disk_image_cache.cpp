@@ -0,0 +1,321 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/disk_image_cache.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/cstdint.hpp>
+
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <signal.h>
+#include <unistd.h>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+// A file is this header, the key it was stored under, padding up to a
+// multiple of 16 bytes, then the RGBA pixels
+struct disk_header
+{
+  char magic[8];
+  boost::uint32_t width, height, opaque, key_size;
+};
+
+char const magic[8] = {'G', 'H', 'T', 'V', 'R', 'G', 'B', 'A'};
+char const extension[] = ".rgba";
+// Temporary files of a process still running are left alone unless this
+// old, in case its pid was reused
+std::time_t const stale_temporary_age = 60 * 60;
+
+std::size_t pixels_offset(std::size_t key_size)
+{
+  return (sizeof(disk_header) + key_size + 15) / 16 * 16;
+}
+
+struct disk_file
+{
+  std::time_t used;
+  std::size_t size;
+};
+
+boost::mutex disk_mutex;
+boost::filesystem::path cache_directory;
+bool enabled = false;
+std::size_t disk_budget = 0;
+std::size_t disk_bytes = 0;
+/// By file name
+std::map<std::string, disk_file> files;
+boost::int64_t disk_hits = 0, disk_misses = 0, disk_evictions = 0;
+/// Tells apart the temporary files of the threads of this process
+unsigned int temporaries = 0;
+
+// Keys hold paths, so files are named after their hash and the key is
+// checked on load
+std::string file_name(std::string const& key)
+{
+  std::ostringstream name;
+  name << std::hex << std::setfill('0') << std::setw(16)
+       << boost::uint64_t(boost::hash<std::string>()(key)) << extension;
+  return name.str();
+}
+
+// Files are written under NAME.PID-N.tmp, one name per writer, so
+// players sharing the directory never write into each other's file
+std::string temporary_name(std::string const& name)
+{
+  std::ostringstream temporary;
+  temporary << name << '.' << ::getpid() << '-' << temporaries++ << ".tmp";
+  return temporary.str();
+}
+
+// Whether the temporary file at @p path was left by a writer that stopped
+// while storing: its process is gone, or it is too old to be written still
+bool stale_temporary(boost::filesystem::path const& path)
+{
+  boost::system::error_code ec;
+  std::time_t const modified = boost::filesystem::last_write_time(path, ec);
+  if(ec || std::time(0) - modified > stale_temporary_age)
+    return true;
+
+  std::string const stem = path.stem().string();
+  std::string::size_type const dot = stem.rfind('.');
+  pid_t const pid = dot == std::string::npos ? 0 : std::atoi(stem.c_str() + dot + 1);
+  return pid > 0 && ::kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+// Called with disk_mutex held
+void forget_disk_file(std::string const& name)
+{
+  std::map<std::string, disk_file>::iterator file = files.find(name);
+  if(file == files.end())
+    return;
+  disk_bytes -= file->second.size;
+  files.erase(file);
+}
+
+// Called with disk_mutex held. Modification times stand for use times,
+// since access times are often not kept.
+void evict_disk_over_budget()
+{
+  while(disk_bytes > disk_budget && !files.empty())
+  {
+    std::map<std::string, disk_file>::iterator oldest = files.begin();
+    for(std::map<std::string, disk_file>::iterator first = files.begin()
+          ; first != files.end(); ++first)
+      if(first->second.used < oldest->second.used)
+        oldest = first;
+
+    boost::system::error_code ec;
+    // Images still mapped stay readable until unmapped
+    boost::filesystem::remove(cache_directory / oldest->first, ec);
+    disk_bytes -= oldest->second.size;
+    files.erase(oldest);
+    ++disk_evictions;
+  }
+}
+
+}
+
+void enable_disk_image_cache(std::string const& directory, std::size_t budget)
+{
+  boost::lock_guard<boost::mutex> lock(disk_mutex);
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(directory, ec);
+  if(ec)
+  {
+    std::cout << "Disk image cache disabled, could not create " << directory << ": "
+              << ec.message() << std::endl;
+    return;
+  }
+
+  cache_directory = directory;
+  disk_budget = budget;
+  enabled = true;
+  for(boost::filesystem::directory_iterator first(cache_directory, ec), last
+        ; !ec && first != last; first.increment(ec))
+  {
+    boost::filesystem::path const& path = first->path();
+    if(path.extension() == ".tmp")
+    {
+      if(stale_temporary(path))
+        boost::filesystem::remove(path, ec);
+      continue;
+    }
+    if(path.extension() != extension)
+      continue;
+    disk_file const file = {boost::filesystem::last_write_time(path, ec)
+                            , std::size_t(boost::filesystem::file_size(path, ec))};
+    files[path.filename().string()] = file;
+    disk_bytes += file.size;
+  }
+  evict_disk_over_budget();
+}
+
+bool disk_image_cache_enabled()
+{
+  boost::lock_guard<boost::mutex> lock(disk_mutex);
+  return enabled;
+}
+
+boost::shared_ptr<decoded_image const> load_disk_cached_image(std::string const& key)
+{
+  std::string const name = file_name(key);
+  boost::filesystem::path path;
+  {
+    boost::lock_guard<boost::mutex> lock(disk_mutex);
+    if(!enabled)
+      return boost::shared_ptr<decoded_image const>();
+    std::map<std::string, disk_file>::iterator file = files.find(name);
+    if(file == files.end())
+    {
+      ++disk_misses;
+      return boost::shared_ptr<decoded_image const>();
+    }
+    path = cache_directory / name;
+  }
+
+  boost::shared_ptr<decoded_image> image(new decoded_image);
+  try
+  {
+    image->mapped.reset(new mapped_file(path.string()));
+  }
+  catch(std::exception const& e)
+  {
+    std::cout << "Disk image cache: " << e.what() << std::endl;
+    boost::lock_guard<boost::mutex> lock(disk_mutex);
+    // Evicted by another player, it is stored again once decoded
+    forget_disk_file(name);
+    ++disk_misses;
+    return boost::shared_ptr<decoded_image const>();
+  }
+
+  mapped_file const& mapped = *image->mapped;
+  disk_header header;
+  bool valid = mapped.size() >= sizeof(header);
+  if(valid)
+  {
+    std::memcpy(&header, mapped.data(), sizeof(header));
+    std::size_t const offset = pixels_offset(header.key_size);
+    valid = !std::memcmp(header.magic, magic, sizeof(magic))
+      && header.key_size == key.size()
+      && mapped.size() == offset + 4u * header.width * header.height
+      && !key.compare(0, key.size(), reinterpret_cast<char const*>(mapped.data())
+                      + sizeof(header), header.key_size);
+  }
+
+  boost::lock_guard<boost::mutex> lock(disk_mutex);
+  if(!valid)
+  {
+    // Not counted nor looked up again, until the decode replaces it
+    forget_disk_file(name);
+    ++disk_misses;
+    return boost::shared_ptr<decoded_image const>();
+  }
+  ++disk_hits;
+  std::map<std::string, disk_file>::iterator file = files.find(name);
+  if(file != files.end())
+  {
+    file->second.used = std::time(0);
+    boost::system::error_code ec;
+    boost::filesystem::last_write_time(path, file->second.used, ec);
+  }
+
+  image->width = header.width;
+  image->height = header.height;
+  image->opaque = header.opaque != 0;
+  image->mapped_pixels = mapped.data() + pixels_offset(header.key_size);
+  return image;
+}
+
+void store_disk_cached_image(std::string const& key, decoded_image const& image)
+{
+  std::string const name = file_name(key);
+  boost::filesystem::path path, temporary;
+  {
+    boost::lock_guard<boost::mutex> lock(disk_mutex);
+    if(!enabled)
+      return;
+    path = cache_directory / name;
+    temporary = cache_directory / temporary_name(name);
+  }
+
+  disk_header header;
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.width = image.width;
+  header.height = image.height;
+  header.opaque = image.opaque;
+  header.key_size = key.size();
+  std::size_t const offset = pixels_offset(key.size());
+  std::size_t const size = offset + 4u * image.width * image.height;
+  char const padding[16] = {0};
+
+  // Written aside and renamed, so no reader ever maps half a file
+  {
+    std::ofstream os(temporary.string().c_str(), std::ios::binary);
+    os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    os.write(key.data(), key.size());
+    os.write(padding, offset - sizeof(header) - key.size());
+    os.write(reinterpret_cast<char const*>(image.pixels()), size - offset);
+    if(!os.flush())
+    {
+      std::cout << "Disk image cache: could not write " << temporary << std::endl;
+      boost::system::error_code ec;
+      boost::filesystem::remove(temporary, ec);
+      return;
+    }
+  }
+  boost::system::error_code ec;
+  boost::filesystem::rename(temporary, path, ec);
+  if(ec)
+  {
+    boost::filesystem::remove(temporary, ec);
+    return;
+  }
+
+  boost::lock_guard<boost::mutex> lock(disk_mutex);
+  forget_disk_file(name);
+  disk_file const stored = {std::time(0), size};
+  files[name] = stored;
+  disk_bytes += size;
+  evict_disk_over_budget();
+}
+
+void print_disk_image_cache_statistics(std::ostream& os)
+{
+  boost::lock_guard<boost::mutex> lock(disk_mutex);
+  if(!enabled)
+    return;
+  os << "disk image cache: " << files.size() << " images, " << disk_bytes / 1024 << " of "
+     << disk_budget / 1024 << " KiB, " << disk_hits << " hits, " << disk_misses << " misses, "
+     << disk_evictions << " evictions" << std::endl;
+}
+
+} } }
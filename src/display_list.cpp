@@ -0,0 +1,187 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/display_list.hpp>
+#include <ghtv/opengl/linux/global_state.hpp>
+#include <ghtv/opengl/linux/static_image.hpp>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <algorithm>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+boost::mutex refresh_mutex;
+/// Players whose textures changed since the last update
+std::vector<opengl::player_base const*> refresh_requests;
+/// The active players may have changed, true until the first update
+bool invalidated = true;
+
+draw_record make_player_record(opengl::player_base* player, opengl::texture& texture
+                               , int x, int y, int zindex)
+{
+  draw_record r = make_draw_record(texture, x, y, zindex);
+  r.player = player;
+  if(static_image const* image = dynamic_cast<static_image const*>(player))
+  {
+    // Players packed in an atlas page only sample their own region
+    if(image->region.valid())
+      std::copy(image->region.uv, image->region.uv + 4, r.uv);
+    r.opaque = image->opaque;
+  }
+  return r;
+}
+
+}
+
+void request_texture_refresh(opengl::player_base const* player)
+{
+  boost::lock_guard<boost::mutex> lock(refresh_mutex);
+  refresh_requests.push_back(player);
+}
+
+void invalidate_display_list()
+{
+  boost::lock_guard<boost::mutex> lock(refresh_mutex);
+  invalidated = true;
+}
+
+display_list::display_list()
+  : entries(), records_(), requested(), rebuild_count(0)
+{
+}
+
+bool display_list::zindex_less(player_entry const& lhs, player_entry const& rhs)
+{
+  return lhs.zindex < rhs.zindex;
+}
+
+void display_list::rebuild()
+{
+  ++rebuild_count;
+  entries.clear();
+  records_.clear();
+
+  // Every active player has an entry, so one that gets a texture or
+  // shows up is found when it asks for a refresh
+  std::list<ghtv::opengl::active_player>& active_players
+    = global_state.main_state.active_players;
+  for(std::list<ghtv::opengl::active_player>::iterator
+        first = active_players.begin(), last = active_players.end()
+        ; first != last; ++first)
+  {
+    if(!first->player)
+      continue;
+    player_entry const entry = {first->player, first->player.get(), first->x, first->y
+                                , first->zindex, first->visible, 0, 0};
+    entries.push_back(entry);
+  }
+  // Same z-index keeps the active players order
+  std::stable_sort(entries.begin(), entries.end(), &zindex_less);
+
+  for(std::vector<player_entry>::iterator first = entries.begin(), last = entries.end()
+        ; first != last; ++first)
+  {
+    // TODO: DRAW MEDIA BORDER
+
+    first->first = records_.size();
+    boost::shared_ptr<opengl::player_base> const player = first->player.lock();
+    if(!first->visible || !player->has_texture())
+      continue;
+
+    ghtv::opengl::texture* textures = 0;
+    unsigned size = 0;
+    player->get_textures(textures, size);
+    for(unsigned i = 0; i < size; ++i)
+    {
+      records_.push_back(make_player_record(player.get(), textures[i]
+                                            , first->x, first->y, first->zindex));
+    }
+    first->count = size;
+  }
+}
+
+bool display_list::refresh(player_entry const& entry, bool& changed)
+{
+  if(!entry.visible)
+    return true;
+  boost::shared_ptr<opengl::player_base> const player = entry.player.lock();
+  if(!player)
+    return false;
+
+  ghtv::opengl::texture* textures = 0;
+  unsigned size = 0;
+  if(player->has_texture())
+    player->get_textures(textures, size);
+  if(size != entry.count)
+    return false;
+
+  for(unsigned i = 0; i < size; ++i)
+  {
+    draw_record const record = make_player_record(player.get(), textures[i]
+                                                  , entry.x, entry.y, entry.zindex);
+    draw_record& old = records_[entry.first + i];
+    if(old.texture == record.texture && old.same_contents(record))
+    {
+      // Only the pixels changed
+      note_texture_update(textures[i]);
+    }
+    else
+    {
+      old = record;
+      changed = true;
+    }
+  }
+  return true;
+}
+
+bool display_list::update()
+{
+  bool rebuild_requested = false;
+  requested.clear();
+  {
+    boost::lock_guard<boost::mutex> lock(refresh_mutex);
+    std::swap(rebuild_requested, invalidated);
+    requested.swap(refresh_requests);
+  }
+
+  if(rebuild_requested)
+  {
+    rebuild();
+    return true;
+  }
+  if(requested.empty())
+    return false;
+
+  std::sort(requested.begin(), requested.end());
+  bool changed = false;
+  for(std::vector<player_entry>::const_iterator first = entries.begin(), last = entries.end()
+        ; first != last; ++first)
+  {
+    if(std::binary_search(requested.begin(), requested.end(), first->address)
+       && !refresh(*first, changed))
+    {
+      rebuild();
+      return true;
+    }
+  }
+  return changed;
+}
+
+} } }
@@ -29,22 +29,70 @@
 #include <ghtv/opengl/linux/draw.hpp>
 #include <ghtv/opengl/texture.hpp>
 #include <ghtv/opengl/linux/global_state.hpp>
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/linux/quad_batch.hpp>
+#include <ghtv/opengl/linux/shader_variants.hpp>
+#include <ghtv/opengl/linux/display_list.hpp>
+#include <ghtv/opengl/linux/frame_stats.hpp>
+#include <ghtv/opengl/linux/image_cache.hpp>
+#include <ghtv/opengl/linux/animation.hpp>
+#include <ghtv/opengl/linux/idle_update.hpp>
+
+#include <vector>
+#include <algorithm>
 
 namespace ghtv { namespace opengl { namespace linux_  {
 
 #ifndef GHTV_USE_GLUT
 extern bool no_draw;
 #endif
-      
+
+namespace {
+
+display_list display;
+quad_batch batch;
+std::vector<std::size_t> visible;
+
+struct opaque_quad
+{
+  shader_variant variant;
+  GLuint texture_id;
+  std::size_t record;
+};
+
+bool batch_order_less(opaque_quad const& lhs, opaque_quad const& rhs)
+{
+  return lhs.variant < rhs.variant
+    || (lhs.variant == rhs.variant && lhs.texture_id < rhs.texture_id);
+}
+
+std::vector<opaque_quad> opaque_quads;
+// Bytes of decoded images uploaded per frame, so a context starting many
+// large images does not make a single frame miss its deadline
+std::size_t const upload_budget = 4u << 20;
+
+}
+
 void draw()
 {
 #ifndef GHTV_USE_GLUT
+  static bool no_draw_presented = false;
   if(no_draw)
   {
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    eglSwapBuffers(global_state.egl_display, global_state.egl_surface);
+    if(!no_draw_presented)
+    {
+      glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      eglSwapBuffers(global_state.egl_display, global_state.egl_surface);
+      no_draw_presented = true;
+    }
     return;
   }
+  if(no_draw_presented)
+  {
+    no_draw_presented = false;
+    damage_screen();
+  }
 #endif
 #ifdef GHTV_USE_OPENMAX
   {
@@ -55,80 +103,74 @@ void draw()
     }
   }
 #endif
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT);
-
-  glUniform1i(global_state.texture_location, 0);
-
-  for(std::list<ghtv::opengl::active_player>::iterator
-        first = global_state.main_state.active_players.begin()
-        , last = global_state.main_state.active_players.end()
-        ;first != last; ++first)
+  boost::int64_t const start = monotonic_microseconds();
+  deliver_decoded_images(upload_budget);
+  if(boost::int64_t const next_change = run_animations(start))
+    schedule_redraw(next_change);
+  bool const records_changed = display.update();
+
+  screen_rect const damage = compute_damage(display.records(), records_changed);
+  if(damage.empty())
   {
-    // std::cout << "texture " << std::endl;
-
-    // TODO: DRAW MEDIA BORDER
+    // Nothing changed since the last frame, the front buffer is still valid
+    return;
+  }
+  screen_rect const repaint = begin_frame(damage);
+  begin_gpu_timer();
 
-    if(first->player && first->player->has_texture() && first->visible)
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // Each record gets its own depth in list order, so the depth test keeps
+  // the z-index and list order even when quads are not drawn back to front
+  std::vector<draw_record> const& records = display.records();
+  GLfloat const depth_step = 1.0f / (records.size() + 1);
+  std::size_t undamaged = 0;
+  std::size_t const culled = cull_records(records, repaint, visible, undamaged);
+  std::size_t const draw_calls = batch.draw_calls();
+
+  // Opaque quads without blending. The depth test keeps their order
+  // whatever order they are drawn in, so they are grouped by shader
+  // variant and texture to share draw calls, and go front to back within
+  // a group so covered fragments are rejected before being shaded
+  glDisable(GL_BLEND);
+  opaque_quads.clear();
+  for(std::size_t i = visible.size(); i-- != 0;)
+  {
+    draw_record const& record = records[visible[i]];
+    if(draws_opaque(record))
     {
-      // std::cout << "texture " << first->player << std::endl;
-      ghtv::opengl::texture* textures = 0;
-      unsigned size = 0;
-      first->player->get_textures(textures, size);
-
-      for(unsigned i=0; i < size; ++i)
-      {
-        ghtv::opengl::texture& texture = textures[i];
-
-        // TODO use all other properties (visible, tranparency, scroll, etc)
-        GLfloat border_ratio[2] = {texture.border_size /(GLfloat)texture.width, texture.border_size /(GLfloat)texture.height};
-        glUniform1f(global_state.z_location, (first->zindex)*std::numeric_limits<float>::epsilon());
-        glUniform4f(global_state.border_color_location, texture.border_color.r, texture.border_color.g, texture.border_color.b, 1.0f);
-
-        // TODO coordinates relative to texture information
-
-        GLfloat left   = (GLfloat)(first->x + texture.x);
-        GLfloat top    = (GLfloat)(first->y + texture.y);
-        GLfloat right  = (GLfloat)(left + texture.width);
-        GLfloat bottom = (GLfloat)(top + texture.height);
-
-        GLfloat vertices[][2] = { {left , top}
-                                , {right, top}
-                                , {left , bottom}
-                                , {right, bottom}};
-
-        GLfloat texture_coords[][2] =  {  {0.0f - border_ratio[0], 0.0f - border_ratio[1]}
-                                        , {1.0f + border_ratio[0], 0.0f - border_ratio[1]}
-                                        , {0.0f - border_ratio[0], 1.0f + border_ratio[1]}
-                                        , {1.0f + border_ratio[0], 1.0f + border_ratio[1]}};
-
-        glUniform4f(global_state.clip_location
-          , texture.clip.left / (GLfloat) texture.width , texture.clip.top / (GLfloat) texture.height
-          , texture.clip.right / (GLfloat) texture.width, texture.clip.bottom / (GLfloat) texture.height);
-
-        glActiveTexture(GL_TEXTURE0);
-        texture.bind();
-
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-        glEnableVertexAttribArray(0);
-
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, texture_coords);
-        glEnableVertexAttribArray(1);
-
-        GLubyte indices[] = {0, 1, 2, 1, 2, 3};
-        glDrawElements(GL_TRIANGLES, sizeof(indices)/sizeof(GLubyte)
-                      , GL_UNSIGNED_BYTE, indices);
-
-        assert(glGetError() == GL_NO_ERROR);
-      }
+      opaque_quad const quad = {select_shader_variant(record), record.texture_id, visible[i]};
+      opaque_quads.push_back(quad);
     }
   }
-
-#if defined(GHTV_USE_GLUT)
-  glutSwapBuffers();
-#else
-  eglSwapBuffers(global_state.egl_display, global_state.egl_surface);
-#endif
+  std::stable_sort(opaque_quads.begin(), opaque_quads.end(), &batch_order_less);
+  for(std::vector<opaque_quad>::const_iterator first = opaque_quads.begin()
+        , last = opaque_quads.end(); first != last; ++first)
+    batch.add(records[first->record], (first->record + 1) * depth_step);
+  batch.flush();
+
+  // Translucent quads back to front over them, without writing depth
+  glEnable(GL_BLEND);
+  glDepthMask(GL_FALSE);
+  for(std::size_t i = 0; i != visible.size(); ++i)
+  {
+    // TODO use all other properties (visible, scroll, etc)
+    if(!draws_opaque(records[visible[i]]))
+      batch.add(records[visible[i]], (visible[i] + 1) * depth_step);
+  }
+  batch.flush();
+  // glClear honours the depth mask
+  glDepthMask(GL_TRUE);
+
+  end_gpu_timer();
+  add_frame_counter(drawn_quads_counter, visible.size());
+  add_frame_counter(culled_quads_counter, culled);
+  add_frame_counter(undamaged_quads_counter, undamaged);
+  add_frame_counter(draw_calls_counter, batch.draw_calls() - draw_calls);
+  // The swap is left out, it may block waiting for vsync
+  record_frame_stat(frame_time_stat, monotonic_microseconds() - start);
+  end_frame(damage);
 }
 
 } } }
@@ -0,0 +1,322 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/etc_encoder.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <climits>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+// Pixel index 0 adds the small modifier, 1 the large one, 2 and 3
+// subtract them
+int const etc1_modifiers[8][2]
+  = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+int const eac_modifiers[16][8]
+  = {{-3, -6, -9, -15, 2, 5, 8, 14}
+     , {-3, -7, -10, -13, 2, 6, 9, 12}
+     , {-2, -5, -8, -13, 1, 4, 7, 12}
+     , {-2, -4, -6, -13, 1, 3, 5, 12}
+     , {-3, -6, -8, -12, 2, 5, 7, 11}
+     , {-3, -7, -9, -11, 2, 6, 8, 10}
+     , {-4, -7, -8, -11, 3, 6, 7, 10}
+     , {-3, -5, -8, -11, 2, 4, 7, 10}
+     , {-2, -6, -8, -10, 1, 5, 7, 9}
+     , {-2, -5, -8, -10, 1, 4, 7, 9}
+     , {-2, -4, -8, -10, 1, 3, 7, 9}
+     , {-2, -5, -7, -10, 1, 4, 6, 9}
+     , {-3, -4, -7, -10, 2, 3, 6, 9}
+     , {-1, -2, -3, -10, 0, 1, 2, 9}
+     , {-4, -6, -8, -9, 3, 5, 7, 8}
+     , {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+// Table and index of the EAC modifier 0, for blocks of a single alpha
+int const eac_exact_table = 13;
+unsigned const eac_exact_index = 4;
+
+std::size_t const block_pixels = 16;
+
+// The pixels of a 4x4 block in the column major order of the index bits:
+// pixel x*4 + y is at column x, row y
+struct block
+{
+  int rgba[block_pixels][4];
+};
+
+inline int clamp_byte(int value)
+{
+  return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+inline int square(int value)
+{
+  return value * value;
+}
+
+// Blocks past the right or bottom edge repeat the last column or row
+void read_block(unsigned char const* rgba, std::size_t width, std::size_t height
+                , std::size_t block_x, std::size_t block_y, block& b)
+{
+  for(std::size_t x = 0; x != 4; ++x)
+    for(std::size_t y = 0; y != 4; ++y)
+    {
+      std::size_t const source_x = std::min(block_x * 4 + x, width - 1);
+      std::size_t const source_y = std::min(block_y * 4 + y, height - 1);
+      unsigned char const* pixel = rgba + 4 * (source_y * width + source_x);
+      std::copy(pixel, pixel + 4, b.rgba[x * 4 + y]);
+    }
+}
+
+void write_big_endian(boost::uint64_t bits, unsigned char* out)
+{
+  for(int i = 7; i >= 0; --i, bits >>= 8)
+    out[i] = bits & 0xFF;
+}
+
+// Flipped blocks are split into top and bottom halves, the others into
+// left and right ones
+inline bool in_half(std::size_t pixel, bool flip, unsigned half)
+{
+  std::size_t const position = flip ? pixel % 4 : pixel / 4;
+  return (position >= 2) == (half != 0);
+}
+
+inline int etc1_modifier(unsigned table, unsigned index)
+{
+  int const modifier = etc1_modifiers[table][index & 1];
+  return index & 2 ? -modifier : modifier;
+}
+
+// Picks the table that best fits the pixels of @p half around @p base,
+// and the index of every one of them. Returns the squared error.
+long fit_half(block const& b, bool flip, unsigned half, int const base[3]
+              , unsigned& table, unsigned indices[block_pixels])
+{
+  long best = LONG_MAX;
+  for(unsigned t = 0; t != 8; ++t)
+  {
+    long error = 0;
+    unsigned candidate[block_pixels];
+    for(std::size_t p = 0; p != block_pixels; ++p)
+    {
+      if(!in_half(p, flip, half))
+        continue;
+      long best_pixel = LONG_MAX;
+      for(unsigned i = 0; i != 4; ++i)
+      {
+        int const modifier = etc1_modifier(t, i);
+        long const pixel_error = square(clamp_byte(base[0] + modifier) - b.rgba[p][0])
+          + square(clamp_byte(base[1] + modifier) - b.rgba[p][1])
+          + square(clamp_byte(base[2] + modifier) - b.rgba[p][2]);
+        if(pixel_error < best_pixel)
+        {
+          best_pixel = pixel_error;
+          candidate[p] = i;
+        }
+      }
+      error += best_pixel;
+    }
+    if(error < best)
+    {
+      best = error;
+      table = t;
+      for(std::size_t p = 0; p != block_pixels; ++p)
+        if(in_half(p, flip, half))
+          indices[p] = candidate[p];
+    }
+  }
+  return best;
+}
+
+// Only the individual and differential modes are produced, without the
+// differential overflows that ETC2 reads as its other modes, so the
+// blocks decode the same as ETC1 and ETC2
+void encode_color_block(block const& b, unsigned char* out)
+{
+  long best_error = LONG_MAX;
+  boost::uint64_t best_bits = 0;
+  for(unsigned flip = 0; flip != 2; ++flip)
+  {
+    int average[2][3] = {{0, 0, 0}, {0, 0, 0}};
+    for(std::size_t p = 0; p != block_pixels; ++p)
+    {
+      unsigned const half = in_half(p, flip, 1) ? 1 : 0;
+      for(std::size_t c = 0; c != 3; ++c)
+        average[half][c] += b.rgba[p][c];
+    }
+    for(std::size_t h = 0; h != 2; ++h)
+      for(std::size_t c = 0; c != 3; ++c)
+        average[h][c] = (average[h][c] + 4) / 8;
+
+    for(unsigned differential = 0; differential != 2; ++differential)
+    {
+      // Base colors quantized to 5 bits, the second as a 3 bit signed
+      // difference, or to 4 bits each
+      int quantized[2][3], base[2][3];
+      bool representable = true;
+      for(std::size_t h = 0; h != 2; ++h)
+        for(std::size_t c = 0; c != 3; ++c)
+        {
+          if(differential)
+          {
+            quantized[h][c] = (average[h][c] * 31 + 127) / 255;
+            base[h][c] = (quantized[h][c] << 3) | (quantized[h][c] >> 2);
+          }
+          else
+          {
+            quantized[h][c] = (average[h][c] * 15 + 127) / 255;
+            base[h][c] = quantized[h][c] * 17;
+          }
+        }
+      if(differential)
+        for(std::size_t c = 0; c != 3; ++c)
+        {
+          int const difference = quantized[1][c] - quantized[0][c];
+          if(difference < -4 || difference > 3)
+            representable = false;
+        }
+      if(!representable)
+        continue;
+
+      unsigned tables[2], indices[block_pixels];
+      long const error = fit_half(b, flip, 0, base[0], tables[0], indices)
+        + fit_half(b, flip, 1, base[1], tables[1], indices);
+      if(error >= best_error)
+        continue;
+      best_error = error;
+
+      boost::uint64_t bits = 0;
+      for(std::size_t c = 0; c != 3; ++c)
+      {
+        boost::uint64_t const color = differential
+          ? (quantized[0][c] << 3) | ((quantized[1][c] - quantized[0][c]) & 7)
+          : (quantized[0][c] << 4) | quantized[1][c];
+        bits |= color << (56 - 8*c);
+      }
+      bits |= boost::uint64_t(tables[0]) << 37 | boost::uint64_t(tables[1]) << 34
+        | boost::uint64_t(differential) << 33 | boost::uint64_t(flip) << 32;
+      for(std::size_t p = 0; p != block_pixels; ++p)
+        bits |= boost::uint64_t(indices[p] >> 1) << (16 + p) | boost::uint64_t(indices[p] & 1) << p;
+      best_bits = bits;
+    }
+  }
+  write_big_endian(best_bits, out);
+}
+
+void encode_alpha_block(block const& b, unsigned char* out)
+{
+  int low = 255, high = 0;
+  for(std::size_t p = 0; p != block_pixels; ++p)
+  {
+    low = std::min(low, b.rgba[p][3]);
+    high = std::max(high, b.rgba[p][3]);
+  }
+
+  int best_base = low, best_multiplier = 1, best_table = eac_exact_table;
+  unsigned best_indices[block_pixels];
+  std::fill(best_indices, best_indices + block_pixels, eac_exact_index);
+  if(low != high)
+  {
+    long best_error = LONG_MAX;
+    for(int t = 0; t != 16; ++t)
+      for(int multiplier = 1; multiplier != 16; ++multiplier)
+      {
+        // Centers the span of the table on the span of the block
+        int const* modifiers = eac_modifiers[t];
+        int const lowest = *std::min_element(modifiers, modifiers + 8) * multiplier;
+        int const highest = *std::max_element(modifiers, modifiers + 8) * multiplier;
+        int const base = clamp_byte((low - lowest + high - highest + 1) / 2);
+
+        long error = 0;
+        unsigned indices[block_pixels];
+        for(std::size_t p = 0; p != block_pixels && error < best_error; ++p)
+        {
+          int best_pixel = INT_MAX;
+          for(unsigned i = 0; i != 8; ++i)
+          {
+            int const pixel_error
+              = square(clamp_byte(base + modifiers[i] * multiplier) - b.rgba[p][3]);
+            if(pixel_error < best_pixel)
+            {
+              best_pixel = pixel_error;
+              indices[p] = i;
+            }
+          }
+          error += best_pixel;
+        }
+        if(error < best_error)
+        {
+          best_error = error;
+          best_base = base;
+          best_multiplier = multiplier;
+          best_table = t;
+          std::copy(indices, indices + block_pixels, best_indices);
+        }
+      }
+  }
+
+  boost::uint64_t bits = boost::uint64_t(best_base) << 56
+    | boost::uint64_t(best_multiplier) << 52 | boost::uint64_t(best_table) << 48;
+  for(std::size_t p = 0; p != block_pixels; ++p)
+    bits |= boost::uint64_t(best_indices[p]) << (45 - 3*p);
+  write_big_endian(bits, out);
+}
+
+void compress(unsigned char const* rgba, std::size_t width, std::size_t height
+              , boost::uint32_t format, compressed_image& image)
+{
+  image.format = format;
+  image.width = width;
+  image.height = height;
+  image.data.resize(compressed_size(format, width, height));
+
+  bool const alpha = format == etc2_rgba8_eac_format;
+  unsigned char* out = &image.data[0];
+  block b;
+  for(std::size_t block_y = 0; block_y != (height + 3) / 4; ++block_y)
+    for(std::size_t block_x = 0; block_x != (width + 3) / 4; ++block_x)
+    {
+      read_block(rgba, width, height, block_x, block_y, b);
+      if(alpha)
+      {
+        encode_alpha_block(b, out);
+        out += 8;
+      }
+      encode_color_block(b, out);
+      out += 8;
+    }
+}
+
+}
+
+void compress_etc1(unsigned char const* rgba, std::size_t width, std::size_t height
+                   , compressed_image& image)
+{
+  compress(rgba, width, height, etc1_rgb8_format, image);
+}
+
+void compress_etc2_eac(unsigned char const* rgba, std::size_t width, std::size_t height
+                       , compressed_image& image)
+{
+  compress(rgba, width, height, etc2_rgba8_eac_format, image);
+}
+
+} } }
@@ -0,0 +1,190 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/event_loop.hpp>
+
+#include <ghtv/opengl/linux/idle_update.hpp>
+#include <ghtv/opengl/linux/handle_events.hpp>
+#include <ghtv/opengl/linux/draw.hpp>
+#include <ghtv/opengl/linux/clock.hpp>
+#include <ghtv/opengl/linux/frame_stats.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+void arm_timer(int timer_fd, boost::int64_t microseconds)
+{
+  itimerspec spec = {};
+  // A zero it_value would disarm the timer
+  microseconds = (std::max)(microseconds, boost::int64_t(1));
+  spec.it_value.tv_sec = microseconds / 1000000;
+  spec.it_value.tv_nsec = (microseconds % 1000000) * 1000;
+  ::timerfd_settime(timer_fd, 0, &spec, 0);
+}
+
+void add_fd(int epoll_fd, int fd)
+{
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+  {
+    throw std::runtime_error(std::string("Could not watch file descriptor: ")
+                             + std::strerror(errno));
+  }
+}
+
+// Returns false if the input device could not be read anymore
+bool read_input(int input_fd, input_event_handler const& handler, bool& handled)
+{
+  input_event events[64];
+  ssize_t r = ::read(input_fd, events, sizeof(events));
+  if(r < ssize_t(sizeof(input_event)))
+  {
+    if(r < 0 && (errno == EINTR || errno == EAGAIN))
+      return true;
+    std::cout << "Error reading input" << std::endl;
+    return false;
+  }
+  for(std::size_t i = 0; i != r / sizeof(input_event); ++i)
+    handled = handler(events[i]) || handled;
+  return true;
+}
+
+}
+
+int run_event_loop(int input_fd, input_event_handler const& handler
+                   , unsigned int frame_interval_ms)
+{
+  int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  int timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if(epoll_fd < 0 || timer_fd < 0 || wakeup_fd() < 0)
+  {
+    std::cerr << "Could not create main loop file descriptors: "
+              << std::strerror(errno) << std::endl;
+    return -1;
+  }
+
+  int exit_status = 0;
+  try
+  {
+    add_fd(epoll_fd, input_fd);
+    add_fd(epoll_fd, wakeup_fd());
+    add_fd(epoll_fd, timer_fd);
+
+    boost::int64_t const frame_interval = frame_interval_ms * 1000;
+    boost::int64_t last_frame = monotonic_microseconds() - frame_interval;
+    // When the timer fires, zero if it is not armed
+    boost::int64_t timer_deadline = 0;
+
+    for(bool quit = false; !quit;)
+    {
+      print_frame_stats_if_requested(std::cout);
+      if(consume_new_events())
+        handle_events();
+
+      int timeout = -1;
+      boost::int64_t now = monotonic_microseconds();
+      // Animations wake the loop up when their next frame is due
+      boost::int64_t wake_time = poll_scheduled_redraw(now);
+      if(redraw_pending())
+      {
+        if(now - last_frame >= frame_interval)
+        {
+          boost::int64_t request_time = consume_redraw();
+          draw();
+          last_frame = monotonic_microseconds();
+          record_frame_stat(present_latency_stat, last_frame - request_time);
+          // Events generated while drawing are handled before sleeping
+          timeout = 0;
+          wake_time = 0;
+        }
+        else
+          wake_time = last_frame + frame_interval;
+      }
+      if(wake_time && wake_time != timer_deadline)
+      {
+        arm_timer(timer_fd, wake_time - now);
+        timer_deadline = wake_time;
+      }
+
+      epoll_event events[3];
+      int n = ::epoll_wait(epoll_fd, events, sizeof(events)/sizeof(events[0]), timeout);
+      if(n < 0 && errno != EINTR)
+      {
+        std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+        exit_status = -1;
+        break;
+      }
+
+      for(int i = 0; i < n; ++i)
+      {
+        int fd = events[i].data.fd;
+        if(fd == input_fd)
+        {
+          bool handled = false;
+          if(!read_input(input_fd, handler, handled))
+          {
+            exit_status = -1;
+            quit = true;
+          }
+          else if(handled)
+          {
+            async_signal_new_event();
+            async_redraw();
+          }
+        }
+        else if(fd == wakeup_fd())
+        {
+          drain_wakeup_fd();
+        }
+        else if(fd == timer_fd)
+        {
+          boost::uint64_t expirations;
+          if(::read(timer_fd, &expirations, sizeof(expirations)) < 0)
+          {
+            // EAGAIN, the timer was already consumed
+          }
+          timer_deadline = 0;
+        }
+      }
+    }
+  }
+  catch(std::exception const& e)
+  {
+    std::cerr << e.what() << std::endl;
+    exit_status = -1;
+  }
+
+  ::close(timer_fd);
+  ::close(epoll_fd);
+  return exit_status;
+}
+
+} } }
@@ -0,0 +1,304 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#endif
+
+#include <ghtv/opengl/linux/frame_stats.hpp>
+#include <ghtv/opengl/linux/idle_update.hpp>
+#include <ghtv/opengl/linux/gl_extensions.hpp>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <iostream>
+
+#include <csignal>
+#include <unistd.h>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+char const* const stat_names[frame_stat_count] =
+  {
+    "frame time"
+    , "gpu frame time"
+    , "handle events"
+    , "texture upload"
+    , "image decode"
+    , "present latency"
+  };
+
+// Percentiles are computed over the last samples only, so a dump shows the
+// current behaviour and not the startup cost
+std::size_t const window_size = 1024;
+
+struct rolling_histogram
+{
+  rolling_histogram()
+    : samples(), next(0), count(0)
+  {}
+
+  void add(boost::int64_t sample)
+  {
+    if(samples.size() < window_size)
+      samples.push_back(sample);
+    else
+      samples[next] = sample;
+    next = (next + 1) % window_size;
+    ++count;
+  }
+
+  void print(char const* name, std::ostream& os) const
+  {
+    if(samples.empty())
+      return;
+    std::vector<boost::int64_t> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    os << "  " << std::setw(16) << std::left << name << std::right
+       << " p50 " << std::setw(9) << percentile(sorted, 50) / 1000.0
+       << "ms p95 " << std::setw(9) << percentile(sorted, 95) / 1000.0
+       << "ms p99 " << std::setw(9) << percentile(sorted, 99) / 1000.0
+       << "ms max " << std::setw(9) << sorted.back() / 1000.0
+       << "ms (" << count << " samples)" << std::endl;
+  }
+
+  static boost::int64_t percentile(std::vector<boost::int64_t> const& sorted, std::size_t p)
+  {
+    return sorted[(sorted.size() - 1) * p / 100];
+  }
+
+  std::vector<boost::int64_t> samples;
+  std::size_t next;
+  boost::int64_t count;
+};
+
+char const* const counter_names[frame_counter_count] =
+  {
+    "drawn quads"
+    , "culled quads"
+    , "undamaged quads"
+    , "draw calls"
+  };
+
+struct counter
+{
+  counter()
+    : frames(0), total(0)
+  {}
+
+  void print(char const* name, std::ostream& os) const
+  {
+    if(!frames)
+      return;
+    os << "  " << std::setw(16) << std::left << name << std::right
+       << " total " << total << ", " << double(total) / frames << " per frame" << std::endl;
+  }
+
+  boost::int64_t frames, total;
+};
+
+boost::mutex stats_mutex;
+rolling_histogram histograms[frame_stat_count];
+counter counters[frame_counter_count];
+
+volatile std::sig_atomic_t dump_requested = 0;
+
+void request_dump(int)
+{
+  dump_requested = 1;
+#ifndef GHTV_USE_GLUT
+  // The signal may be delivered to another thread, so the main loop is
+  // woken up explicitly. write is async-signal-safe.
+  boost::uint64_t one = 1;
+  if(::write(wakeup_fd(), &one, sizeof(one)) != sizeof(one))
+  {
+  }
+#endif
+}
+
+GLenum const time_elapsed = 0x88BF;
+GLenum const query_result = 0x8866;
+GLenum const query_result_available = 0x8867;
+GLenum const gpu_disjoint = 0x8FBB;
+
+typedef void (*gen_queries_function)(GLsizei, GLuint*);
+typedef void (*begin_query_function)(GLenum, GLuint);
+typedef void (*end_query_function)(GLenum);
+typedef void (*get_query_objectiv_function)(GLuint, GLenum, GLint*);
+typedef void (*get_query_objectui64v_function)(GLuint, GLenum, boost::uint64_t*);
+
+// Queries in flight, the GPU is usually at most a couple of frames behind
+std::size_t const query_count = 4;
+
+struct gpu_timer_state
+{
+  gpu_timer_state()
+    : initialized(false), available(false), has_disjoint(false), next(0), running(false)
+    , gen_queries(0), begin_query(0), end_query(0)
+    , get_query_objectiv(0), get_query_objectui64v(0)
+  {
+    std::fill(queries, queries + query_count, 0u);
+    std::fill(pending, pending + query_count, false);
+  }
+
+  void initialize()
+  {
+    initialized = true;
+    std::string suffix;
+    if(has_gl_extension("GL_EXT_disjoint_timer_query"))
+    {
+      suffix = "EXT";
+      has_disjoint = true;
+    }
+    else if(!has_gl_extension("GL_ARB_timer_query"))
+    {
+      std::cout << "frame stats: no GPU timer queries" << std::endl;
+      return;
+    }
+
+    gen_queries = (gen_queries_function)get_gl_proc_address("glGenQueries" + suffix);
+    begin_query = (begin_query_function)get_gl_proc_address("glBeginQuery" + suffix);
+    end_query = (end_query_function)get_gl_proc_address("glEndQuery" + suffix);
+    get_query_objectiv = (get_query_objectiv_function)
+      get_gl_proc_address("glGetQueryObjectiv" + suffix);
+    get_query_objectui64v = (get_query_objectui64v_function)
+      get_gl_proc_address("glGetQueryObjectui64v" + suffix);
+    available = gen_queries && begin_query && end_query
+      && get_query_objectiv && get_query_objectui64v;
+    if(available)
+      gen_queries(query_count, queries);
+    std::cout << "frame stats: GPU timer queries " << (available ? "yes" : "no") << std::endl;
+  }
+
+  void collect()
+  {
+    // A disjoint operation (e.g. frequency change) invalidates every
+    // query in flight
+    GLint disjoint = 0;
+    if(has_disjoint)
+      glGetIntegerv(gpu_disjoint, &disjoint);
+
+    for(std::size_t i = 0; i != query_count; ++i)
+    {
+      if(!pending[i])
+        continue;
+      GLint ready = 0;
+      get_query_objectiv(queries[i], query_result_available, &ready);
+      if(!ready)
+        continue;
+      boost::uint64_t nanoseconds = 0;
+      get_query_objectui64v(queries[i], query_result, &nanoseconds);
+      pending[i] = false;
+      if(!disjoint)
+        record_frame_stat(gpu_frame_time_stat, boost::int64_t(nanoseconds / 1000));
+    }
+  }
+
+  bool initialized, available, has_disjoint;
+  GLuint queries[query_count];
+  bool pending[query_count];
+  std::size_t next;
+  bool running;
+
+  gen_queries_function gen_queries;
+  begin_query_function begin_query;
+  end_query_function end_query;
+  get_query_objectiv_function get_query_objectiv;
+  get_query_objectui64v_function get_query_objectui64v;
+};
+
+gpu_timer_state gpu_timer;
+
+}
+
+void record_frame_stat(frame_stat stat, boost::int64_t microseconds)
+{
+  boost::lock_guard<boost::mutex> lock(stats_mutex);
+  histograms[stat].add(microseconds);
+}
+
+void add_frame_counter(frame_counter c, std::size_t value)
+{
+  boost::lock_guard<boost::mutex> lock(stats_mutex);
+  ++counters[c].frames;
+  counters[c].total += value;
+}
+
+void begin_gpu_timer()
+{
+  if(!gpu_timer.initialized)
+    gpu_timer.initialize();
+  if(!gpu_timer.available)
+    return;
+
+  gpu_timer.collect();
+  // Skips this frame if the GPU is too far behind to reuse the query
+  if(gpu_timer.pending[gpu_timer.next])
+    return;
+  gpu_timer.begin_query(time_elapsed, gpu_timer.queries[gpu_timer.next]);
+  gpu_timer.running = true;
+}
+
+void end_gpu_timer()
+{
+  if(!gpu_timer.running)
+    return;
+  gpu_timer.end_query(time_elapsed);
+  gpu_timer.running = false;
+  gpu_timer.pending[gpu_timer.next] = true;
+  gpu_timer.next = (gpu_timer.next + 1) % query_count;
+}
+
+void print_frame_stats(std::ostream& os)
+{
+  boost::lock_guard<boost::mutex> lock(stats_mutex);
+  os << "frame stats:" << std::endl;
+  for(std::size_t i = 0; i != frame_stat_count; ++i)
+    histograms[i].print(stat_names[i], os);
+  for(std::size_t i = 0; i != frame_counter_count; ++i)
+    counters[i].print(counter_names[i], os);
+}
+
+void install_frame_stats_signal_handler()
+{
+  struct sigaction action = {};
+  action.sa_handler = &request_dump;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  ::sigaction(SIGUSR1, &action, 0);
+}
+
+void print_frame_stats_if_requested(std::ostream& os)
+{
+  if(dump_requested)
+  {
+    dump_requested = 0;
+    print_frame_stats(os);
+  }
+}
+
+} } }
@@ -0,0 +1,71 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#include <GL/glx.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#endif
+#ifndef GHTV_USE_GLUT
+#include <EGL/egl.h>
+#endif
+
+#include <ghtv/opengl/linux/gl_extensions.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <cstdio>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+bool has_gl_extension(std::string const& name)
+{
+  char const* extensions = reinterpret_cast<char const*>(glGetString(GL_EXTENSIONS));
+  return extensions
+    && boost::algorithm::contains(" " + std::string(extensions) + " ", " " + name + " ");
+}
+
+bool gl_version_at_least(bool es, int major, int minor)
+{
+  char const* version = reinterpret_cast<char const*>(glGetString(GL_VERSION));
+  if(!version)
+    return false;
+
+  // "OpenGL ES 3.0 Mesa ..." or "4.6 (Compatibility Profile) Mesa ..."
+  std::string const es_prefix = "OpenGL ES ";
+  bool const is_es = boost::algorithm::starts_with(version, es_prefix);
+  if(is_es != es)
+    return false;
+  int context_major = 0, context_minor = 0;
+  if(std::sscanf(version + (is_es ? es_prefix.size() : 0), "%d.%d"
+                 , &context_major, &context_minor) != 2)
+    return false;
+  return context_major > major || (context_major == major && context_minor >= minor);
+}
+
+void* get_gl_proc_address(std::string const& name)
+{
+#ifdef GHTV_USE_GLUT
+  return reinterpret_cast<void*>
+    (glXGetProcAddressARB(reinterpret_cast<GLubyte const*>(name.c_str())));
+#else
+  return reinterpret_cast<void*>(eglGetProcAddress(name.c_str()));
+#endif
+}
+
+} } }
@@ -25,6 +25,8 @@
 #include <ghtv/opengl/linux/handle_events.hpp>
 
 #include <ghtv/opengl/linux/global_state.hpp>
+#include <ghtv/opengl/linux/frame_stats.hpp>
+#include <ghtv/opengl/linux/display_list.hpp>
 
 #include <gntl/algorithm/structure/port/start_action_traits.ipp>
 #include <gntl/algorithm/structure/port/start.ipp>
@@ -60,6 +62,7 @@ namespace ghtv { namespace opengl { namespace linux_ {
 
 void handle_events()
 {
+  scoped_stat_timer timer(events_time_stat);
   gntl::algorithm::structure::media::dimensions const screen_dimensions
     = {0, 0, global_state.width, global_state.height, 0};
 
@@ -70,6 +73,8 @@ void handle_events()
     document_traits::event_type event = document_traits::top_event
       (*global_state.main_state.document);
     document_traits::pop_event (*global_state.main_state.document);
+    // Links may start, stop or move players
+    invalidate_display_list();
 
     try
     {
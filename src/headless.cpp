@@ -0,0 +1,337 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <ghtv/opengl/linux/headless.hpp>
+
+#include <ghtv/opengl/linux/global_state.hpp>
+#include <ghtv/opengl/linux/idle_update.hpp>
+#include <ghtv/opengl/linux/handle_events.hpp>
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/linux/draw.hpp>
+#include <ghtv/opengl/linux/clock.hpp>
+#include <ghtv/opengl/linux/frame_stats.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/cstdint.hpp>
+
+#include <png.h>
+
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <poll.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+typedef EGLDisplay (EGLAPIENTRYP get_platform_display_function)
+  (EGLenum platform, void* native_display, EGLint const* attrib_list);
+
+bool has_extension(char const* extensions, char const* name)
+{
+  if(!extensions)
+    return false;
+  std::size_t const length = std::strlen(name);
+  for(char const* p = std::strstr(extensions, name); p; p = std::strstr(p + length, name))
+  {
+    if((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+      return true;
+  }
+  return false;
+}
+
+EGLDisplay get_headless_display()
+{
+  // Client extensions, queried without a display
+  char const* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if(has_extension(extensions, "EGL_MESA_platform_surfaceless"))
+  {
+    get_platform_display_function get_platform_display
+      = reinterpret_cast<get_platform_display_function>
+      (eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if(get_platform_display)
+    {
+      EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA
+                                                , EGL_DEFAULT_DISPLAY, 0);
+      if(display != EGL_NO_DISPLAY)
+        return display;
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool choose_config(EGLDisplay display, EGLint surface_type, EGLConfig& config)
+{
+  EGLint const attribs[] =
+    {
+      EGL_RED_SIZE, 8,
+      EGL_GREEN_SIZE, 8,
+      EGL_BLUE_SIZE, 8,
+      EGL_ALPHA_SIZE, 8,
+      EGL_DEPTH_SIZE, 16,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+      EGL_SURFACE_TYPE, surface_type,
+      EGL_NONE
+    };
+  EGLint configs = 0;
+  return eglChooseConfig(display, attribs, &config, 1, &configs) && configs > 0;
+}
+
+// Render target of the surfaceless context
+bool create_framebuffer()
+{
+  GLuint color = 0, depth = 0, framebuffer = 0;
+  glGenTextures(1, &color);
+  glBindTexture(GL_TEXTURE_2D, color);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, global_state.width, global_state.height, 0
+               , GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16
+                        , global_state.width, global_state.height);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+  return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+bool write_png(std::string const& path, std::vector<unsigned char>& pixels
+               , std::size_t width, std::size_t height)
+{
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if(!file)
+    return false;
+
+  png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+  png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : 0;
+  if(!info_ptr || setjmp(png_jmpbuf(png_ptr)))
+  {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    std::fclose(file);
+    return false;
+  }
+
+  png_init_io(png_ptr, file);
+  png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGBA
+               , PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png_ptr, info_ptr);
+
+  // glReadPixels returns the bottom row first
+  std::vector<png_bytep> rows(height);
+  for(std::size_t i = 0; i != height; ++i)
+    rows[i] = &pixels[(height - 1 - i) * width * 4];
+  png_write_image(png_ptr, &rows[0]);
+  png_write_end(png_ptr, 0);
+
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  return std::fclose(file) == 0;
+}
+
+bool dump_frame(std::string const& dump_dir, unsigned int frame
+                , std::vector<unsigned char>& pixels)
+{
+  std::size_t const width = global_state.width, height = global_state.height;
+  pixels.resize(width * height * 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+
+  char name[32];
+  std::sprintf(name, "frame-%05u.png", frame);
+  return write_png((boost::filesystem::path(dump_dir) / name).string()
+                   , pixels, width, height);
+}
+
+// Handles events until @p deadline, without busy waiting
+void wait_until(boost::int64_t deadline)
+{
+  for(boost::int64_t now = monotonic_microseconds(); now < deadline
+        ; now = monotonic_microseconds())
+  {
+    pollfd fd = {wakeup_fd(), POLLIN, 0};
+    int timeout = int((deadline - now + 999) / 1000);
+    if(::poll(&fd, 1, timeout) > 0)
+      drain_wakeup_fd();
+    print_frame_stats_if_requested(std::cout);
+    if(consume_new_events())
+      handle_events();
+  }
+}
+
+struct frame_cost
+{
+  frame_cost()
+    : frames(0), total(0), min(0), max(0)
+  {}
+
+  void add(boost::int64_t cost)
+  {
+    min = frames ? (std::min)(min, cost) : cost;
+    max = (std::max)(max, cost);
+    total += cost;
+    ++frames;
+  }
+
+  void print(std::ostream& os) const
+  {
+    if(!frames)
+      return;
+    os << "headless: " << frames << " frames, frame cost avg "
+       << (total / frames) / 1000.0 << "ms min " << min / 1000.0
+       << "ms max " << max / 1000.0 << "ms" << std::endl;
+  }
+
+  boost::int64_t frames, total, min, max;
+};
+
+}
+
+bool create_headless_context()
+{
+  global_state.egl_display = get_headless_display();
+  EGLint major, minor;
+  if(global_state.egl_display == EGL_NO_DISPLAY
+     || !eglInitialize(global_state.egl_display, &major, &minor))
+  {
+    std::cout << "Failed initializing headless display" << std::endl;
+    return false;
+  }
+  if(!eglBindAPI(EGL_OPENGL_ES_API))
+  {
+    std::cout << "Failed binding OpenGL ES API" << std::endl;
+    return false;
+  }
+
+  EGLConfig config;
+  bool const pbuffer = choose_config(global_state.egl_display, EGL_PBUFFER_BIT, config);
+  if(!pbuffer)
+  {
+    char const* extensions = eglQueryString(global_state.egl_display, EGL_EXTENSIONS);
+    if(!has_extension(extensions, "EGL_KHR_surfaceless_context")
+       || !choose_config(global_state.egl_display, 0, config))
+    {
+      std::cout << "No pbuffer or surfaceless EGL config available" << std::endl;
+      return false;
+    }
+  }
+
+  EGLint const context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+  global_state.egl_context = eglCreateContext(global_state.egl_display, config
+                                              , EGL_NO_CONTEXT, context_attribs);
+  if(global_state.egl_context == EGL_NO_CONTEXT)
+  {
+    std::cout << "Failed creating headless context" << std::endl;
+    return false;
+  }
+
+  if(pbuffer)
+  {
+    EGLint const surface_attribs[] =
+      { EGL_WIDTH, global_state.width, EGL_HEIGHT, global_state.height, EGL_NONE };
+    global_state.egl_surface = eglCreatePbufferSurface(global_state.egl_display, config
+                                                       , surface_attribs);
+    if(global_state.egl_surface == EGL_NO_SURFACE)
+    {
+      std::cout << "Failed creating pbuffer surface" << std::endl;
+      return false;
+    }
+  }
+
+  if(eglMakeCurrent(global_state.egl_display, global_state.egl_surface
+                    , global_state.egl_surface, global_state.egl_context) == EGL_FALSE)
+  {
+    std::cout << "Failed making current headless context" << std::endl;
+    return false;
+  }
+
+  if(!pbuffer && !create_framebuffer())
+  {
+    std::cout << "Failed creating headless framebuffer" << std::endl;
+    return false;
+  }
+
+  std::cout << "headless: EGL " << major << '.' << minor << ", "
+            << (pbuffer ? "pbuffer" : "surfaceless framebuffer") << ", "
+            << glGetString(GL_RENDERER) << std::endl;
+  return true;
+}
+
+int run_headless_loop(unsigned int frames, unsigned int frame_interval_ms
+                      , std::string const& dump_dir)
+{
+  if(!dump_dir.empty())
+  {
+    boost::system::error_code error;
+    boost::filesystem::create_directories(dump_dir, error);
+    if(error)
+    {
+      std::cerr << "Could not create " << dump_dir << ": " << error.message() << std::endl;
+      return -1;
+    }
+  }
+
+  boost::int64_t const frame_interval = frame_interval_ms * 1000;
+  boost::int64_t next_frame = monotonic_microseconds();
+  frame_cost costs;
+  std::vector<unsigned char> pixels;
+  for(unsigned int frame = 0; frame != frames; ++frame)
+  {
+    wait_until(next_frame);
+    next_frame += frame_interval;
+
+    if(consume_new_events())
+      handle_events();
+    if(redraw_pending())
+      consume_redraw();
+
+    // Every frame is drawn in full, so its cost and dump do not depend on
+    // what changed since the previous one
+    damage_screen();
+    boost::int64_t const start = monotonic_microseconds();
+    draw();
+    glFinish();
+    costs.add(monotonic_microseconds() - start);
+
+    if(!dump_dir.empty() && !dump_frame(dump_dir, frame, pixels))
+    {
+      std::cerr << "Could not write frame " << frame << " to " << dump_dir << std::endl;
+      return -1;
+    }
+  }
+  costs.print(std::cout);
+  return 0;
+}
+
+} } }
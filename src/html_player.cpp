@@ -27,8 +27,12 @@
 #include <ghtv/opengl/texture.hpp>
 
 #include <ghtv/opengl/linux/url_join.hpp>
-#include <ghtv/opengl/linux/load_image.hpp>
+#include <ghtv/opengl/linux/image_cache.hpp>
 #include <ghtv/opengl/linux/image_conversion.hpp>
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/linux/display_list.hpp>
+#include <ghtv/opengl/linux/global_state.hpp>
+#include <ghtv/opengl/linux/texture_upload.hpp>
 
 #include <litehtml.h>
 #include <cairo.h>
@@ -84,6 +88,9 @@ public:
   cairo_t* m_temp_cairo_cr;
 
   std::vector<opengl::texture> m_textures;
+  texture_uploader m_uploader;
+  /// The cairo surface changed since the last upload
+  bool m_dirty;
 
   /// @warning The litehtml::document destructor calls methods from the
   /// litehtml::document_container (in this case the html_player_impl).
@@ -116,6 +123,8 @@ public:
     , m_temp_cairo_surface(0)
     , m_temp_cairo_cr(0)
     , m_textures()
+    , m_uploader()
+    , m_dirty(false)
     , m_html_doc()
   {
     // TODO Grant UTF-8 encoding
@@ -127,16 +136,26 @@ public:
 
     {
       Display* display = XOpenDisplay(NULL);
-      int screen = 0;
-      m_screen_width_px = XDisplayWidth(display, screen);
-      m_screen_height_px = XDisplayHeight(display, screen);
+      if(display)
+      {
+        int screen = 0;
+        m_screen_width_px = XDisplayWidth(display, screen);
+        m_screen_height_px = XDisplayHeight(display, screen);
 // #ifdef GHTV_OPENGL_LINUX_HTML_PLAYER_CALC_SCREEN_PPI
-      // 1 inch = 25.4 millimetres
-      m_screen_ppi = m_screen_width_px * 25.4 / XDisplayWidthMM(display, screen);
+        // 1 inch = 25.4 millimetres
+        m_screen_ppi = m_screen_width_px * 25.4 / XDisplayWidthMM(display, screen);
+// #endif
+        XCloseDisplay(display);
+      }
+      else
+      {
+        // No X server, as in the headless and dispmanx builds
+        m_screen_width_px = global_state.width;
+        m_screen_height_px = global_state.height;
+        m_screen_ppi = 96.0;
+      }
       // 1 point = 1/72 inch
       m_screen_pixels_per_point = m_screen_ppi / 72.0;
-// #endif
-      XCloseDisplay(display);
     }
 
     m_temp_cairo_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 2, 2);
@@ -195,6 +214,7 @@ public:
     m_html_doc = litehtml::document::createFromString(m_html_file.file_content_p(), this, &m_html_context, 0);
     m_html_doc->render(m_width);
     m_html_doc->draw(this, -m_x, -m_y, &m_client_clip);
+    m_dirty = true;
   }
 
   void get_textures(texture*& textures, unsigned& size)
@@ -203,32 +223,26 @@ public:
     if(!size)
       return;
 
-    // TODO: Dirty flag?
-    // TODO: Optimize for desktop OpenGL?
+    textures = &(m_textures[0]);
+    if(!m_dirty)
+      return;
+    m_dirty = false;
 
     cairo_surface_flush(m_html_cr_surface);
-    std::vector<unsigned char> rgba_data;
-    rgba_from_cairo_ARGB32(
+    std::vector<unsigned char> pixels;
+    bool const bgra = bgra_upload_supported();
+    (bgra ? unpremultiplied_bgra_from_cairo_ARGB32 : unpremultiplied_rgba_from_cairo_ARGB32)(
       cairo_image_surface_get_data(m_html_cr_surface)
       , m_width
       , m_height
       , cairo_image_surface_get_stride(m_html_cr_surface)
-      , rgba_data
+      , pixels
     );
 
-    glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
-    m_textures.front().bind();
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &(rgba_data[0]));
+    m_uploader.upload(m_textures.front(), &pixels[0], m_width, m_height
+                      , bgra ? bgra_pixels : rgba_pixels);
 
-    assert(glGetError() == GL_NO_ERROR);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    assert(glGetError() == GL_NO_ERROR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    assert(glGetError() == GL_NO_ERROR);
-
-    textures = &(m_textures[0]);
+    note_texture_update(m_textures.front());
   }
 
   std::string make_url_str(std::string const& basepath, std::string const& url)
@@ -525,7 +539,9 @@ public:
       if(m_images.find(image_url) == m_images.end())
       {
         binary_file image_file(m_html_file.root(), m_base_url, image_url);
-        opengl::texture t = opengl::linux_::load_image(image_file);
+        boost::shared_ptr<decoded_image const> image = load_cached_image(image_file);
+        opengl::texture t;
+        upload_texture(t, image->pixels(), image->width, image->height);
         m_images[image_url] = t;
       }
     }
@@ -991,6 +1007,7 @@ html_player::~html_player()
 void html_player::start()
 {
   impl->parse_and_draw();
+  request_texture_refresh(this);
 }
 
 void html_player::get_textures(opengl::texture*& textures, unsigned& size)
@@ -18,22 +18,50 @@
 
 #include <ghtv/opengl/linux/draw.hpp>
 #include <ghtv/opengl/linux/handle_events.hpp>
+#include <ghtv/opengl/linux/clock.hpp>
+#include <ghtv/opengl/linux/frame_stats.hpp>
 
 #include <boost/atomic.hpp>
 
 #include <iostream>
 
+#ifndef GHTV_USE_GLUT
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 namespace ghtv { namespace opengl { namespace linux_ {
 
 namespace {
 boost::atomic_bool redraw(true);
 boost::atomic_bool has_new_events(true);
+// Zero means no redraw is scheduled
+boost::atomic<boost::int64_t> scheduled_redraw_time(0);
+
+#ifndef GHTV_USE_GLUT
+// Zero means no redraw was requested since the last frame
+boost::atomic<boost::int64_t> redraw_request_time(0);
+
+int const wakeup_event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+void wakeup()
+{
+  boost::uint64_t one = 1;
+  if(::write(wakeup_event_fd, &one, sizeof(one)) != sizeof(one))
+  {
+    // Only fails if the counter would overflow, in which case the loop is
+    // already going to wake up.
+  }
+}
+#endif
 }
 
 // TODO glutPostRedisplay instead ???
 
 void glut_idle_update_function()
 {
+  print_frame_stats_if_requested(std::cout);
+  poll_scheduled_redraw(monotonic_microseconds());
   if(has_new_events) {
     has_new_events = false;
     handle_events();
@@ -46,12 +74,71 @@ void glut_idle_update_function()
 
 void async_redraw()
 {
+#ifndef GHTV_USE_GLUT
+  boost::int64_t expected = 0;
+  redraw_request_time.compare_exchange_strong(expected, monotonic_microseconds());
+#endif
   redraw = true;
+#ifndef GHTV_USE_GLUT
+  wakeup();
+#endif
 }
 
 void async_signal_new_event()
 {
   has_new_events = true;
+#ifndef GHTV_USE_GLUT
+  wakeup();
+#endif
+}
+
+void schedule_redraw(boost::int64_t time)
+{
+  boost::int64_t scheduled = scheduled_redraw_time;
+  while((!scheduled || time < scheduled)
+        && !scheduled_redraw_time.compare_exchange_weak(scheduled, time))
+    ;
+}
+
+boost::int64_t poll_scheduled_redraw(boost::int64_t now)
+{
+  boost::int64_t scheduled = scheduled_redraw_time;
+  if(!scheduled || now < scheduled)
+    return scheduled;
+  if(scheduled_redraw_time.compare_exchange_strong(scheduled, 0))
+    async_redraw();
+  return 0;
+}
+
+#ifndef GHTV_USE_GLUT
+int wakeup_fd()
+{
+  return wakeup_event_fd;
+}
+
+void drain_wakeup_fd()
+{
+  boost::uint64_t counter;
+  while(::read(wakeup_event_fd, &counter, sizeof(counter)) == sizeof(counter))
+    ;
+}
+
+bool consume_new_events()
+{
+  return has_new_events.exchange(false);
+}
+
+bool redraw_pending()
+{
+  return redraw;
+}
+
+boost::int64_t consume_redraw()
+{
+  redraw = false;
+  boost::int64_t request_time = redraw_request_time.exchange(0);
+  return request_time ? request_time : monotonic_microseconds();
 }
+#endif
 
 } } }
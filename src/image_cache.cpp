@@ -0,0 +1,527 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/image_cache.hpp>
+#include <ghtv/opengl/linux/disk_image_cache.hpp>
+
+#include <ghtv/opengl/linux/load_png.hpp>
+#include <ghtv/opengl/linux/load_jpg.hpp>
+#include <ghtv/opengl/linux/load_gif.hpp>
+#include <ghtv/opengl/linux/image_conversion.hpp>
+#include <ghtv/opengl/linux/idle_update.hpp>
+#include <ghtv/opengl/linux/frame_stats.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <list>
+#include <deque>
+#include <vector>
+#include <sstream>
+#include <ctime>
+#include <cstdlib>
+#include <stdexcept>
+#include <iostream>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+struct cache_entry
+{
+  boost::shared_ptr<decoded_image const> image;
+  /// Position in the use order
+  std::list<std::string>::iterator use;
+};
+
+struct decode_job
+{
+  decode_job(binary_file const& file, std::size_t min_width, std::size_t min_height
+             , image_ready_callback const& ready)
+    : file(file), min_width(min_width), min_height(min_height), ready(ready)
+  {}
+
+  binary_file file;
+  std::size_t min_width, min_height;
+  /// Empty for prefetches
+  image_ready_callback ready;
+};
+
+struct decoded_delivery
+{
+  boost::shared_ptr<decoded_image const> image;
+  image_ready_callback ready;
+};
+
+// Animated GIFs up to this size have all their frames composed once
+std::size_t const composed_gif_budget = 8u << 20;
+
+boost::mutex cache_mutex;
+boost::condition_variable decoded_condition;
+std::map<std::string, cache_entry> entries;
+/// Keys from the most to the least recently used
+std::list<std::string> use_order;
+/// Keys being decoded by some thread
+std::set<std::string> decoding;
+/// Formats KTX sidecars are loaded in, written before any decode starts
+std::vector<boost::uint32_t> compressed_formats;
+std::size_t cache_budget = 64u << 20;
+std::size_t cache_bytes = 0;
+boost::int64_t hits = 0, misses = 0, evictions = 0;
+
+std::deque<decode_job> decode_queue;
+/// Signalled when jobs are queued or the decoders are stopped
+boost::condition_variable queued_condition;
+/// Workers started with the first job, waiting for more while the queue
+/// is empty, until stop_image_prefetch joins them
+std::vector<boost::shared_ptr<boost::thread> > decode_threads;
+bool decoders_started = false;
+bool stopping_decoders = false;
+
+boost::mutex delivery_mutex;
+std::deque<decoded_delivery> deliveries;
+
+bool scaled_decode(std::string const& source)
+{
+  return boost::algorithm::iends_with(source, ".jpeg")
+    || boost::algorithm::iends_with(source, ".jpg");
+}
+
+// Whether @p file can have a KTX sidecar, without looking for it
+bool sidecar_candidate(binary_file const& file)
+{
+  return !compressed_formats.empty() && file.is_local()
+    && !boost::algorithm::iends_with(file.source_uri(), ".gif");
+}
+
+// The KTX sidecar, written by ktx-transcode, to load a texture from
+// instead of decoding @p file, if it is not older than the image
+boost::optional<binary_file> texture_sidecar(binary_file const& file)
+{
+  std::string const& source = file.source_uri();
+  if(!sidecar_candidate(file))
+    return boost::none;
+
+  binary_file const sidecar(file.root(), ktx_sidecar_path(source));
+  boost::system::error_code ec;
+  std::time_t const sidecar_modified
+    = boost::filesystem::last_write_time(sidecar.file_posix_path(), ec);
+  if(ec)
+    return boost::none;
+  std::time_t const modified = boost::filesystem::last_write_time(file.file_posix_path(), ec);
+  if(ec || sidecar_modified < modified)
+    return boost::none;
+  return sidecar;
+}
+
+// Sidecars in a format the context cannot sample are ignored
+bool load_sidecar(binary_file const& sidecar, decoded_image& image)
+{
+  boost::shared_ptr<compressed_image> compressed(new compressed_image);
+  try
+  {
+    file_bytes bytes(sidecar);
+    load_ktx(bytes.data(), bytes.size(), *compressed);
+  }
+  catch(std::exception const& e)
+  {
+    std::cout << "Ignoring " << sidecar.source_uri() << ": " << e.what() << std::endl;
+    return false;
+  }
+  if(std::find(compressed_formats.begin(), compressed_formats.end(), compressed->format)
+     == compressed_formats.end())
+    return false;
+
+  image.width = compressed->width;
+  image.height = compressed->height;
+  image.opaque = compressed->opaque();
+  image.compressed = compressed;
+  return true;
+}
+
+// What uploading the image costs, the frames of animations go later
+std::size_t upload_size(decoded_image const& image)
+{
+  return image.compressed ? image.compressed->data.size() : 4 * image.width * image.height;
+}
+
+// The texture loaded from the sidecar of @p file, null if there is none
+// or it is larger than decoding @p file for @p min_width x @p min_height,
+// as a JPEG scaled down to a thumbnail is
+boost::shared_ptr<decoded_image const> sidecar_image
+  (binary_file const& file, std::size_t min_width, std::size_t min_height)
+{
+  boost::optional<binary_file> const sidecar = texture_sidecar(file);
+  boost::shared_ptr<decoded_image> image(new decoded_image);
+  if(!sidecar || !load_sidecar(*sidecar, *image))
+    return boost::shared_ptr<decoded_image const>();
+
+  std::size_t decoded_width = image->width, decoded_height = image->height;
+#ifndef GHTV_USE_OPENMAX
+  if(scaled_decode(file.source_uri()))
+    jpg_scaled_size(decoded_width, decoded_height, min_width, min_height);
+#endif
+  if(upload_size(*image) > 4 * decoded_width * decoded_height)
+    return boost::shared_ptr<decoded_image const>();
+  return image;
+}
+
+std::string cache_key(binary_file const& file, std::size_t min_width, std::size_t min_height
+                      , bool texture)
+{
+  std::ostringstream key;
+  // Whether the sidecar or a decode is used is found once, on a miss,
+  // and kept under this key. Lookups do not touch the sidecar.
+  if(texture && sidecar_candidate(file))
+    key << "tex:";
+  if(scaled_decode(file.source_uri()) && min_width && min_height)
+    key << min_width << 'x' << min_height << ':';
+  if(!file.is_local())
+  {
+    key << file.url();
+    return key.str();
+  }
+
+  boost::system::error_code ec;
+  boost::filesystem::path path = boost::filesystem::canonical(file.file_posix_path(), ec);
+  if(ec)
+    path = file.file_posix_path();
+  std::time_t const modified = boost::filesystem::last_write_time(path, ec);
+  key << path.string() << '@' << (ec ? std::time_t(0) : modified);
+  return key.str();
+}
+
+// The disk cache key of the decode of @p file cached under @p key,
+// empty for images it does not keep: remote ones, whose changes are
+// unknown. Textures decode to the same pixels as other images. The size
+// guards against a file rewritten within the second of its modification
+// time.
+std::string disk_cache_key(binary_file const& file, std::string const& key)
+{
+  if(!disk_image_cache_enabled() || !file.is_local())
+    return std::string();
+
+  boost::system::error_code ec;
+  boost::uintmax_t const size = boost::filesystem::file_size(file.file_posix_path(), ec);
+  if(ec)
+    return std::string();
+  std::ostringstream disk_key;
+  disk_key << (boost::algorithm::starts_with(key, "tex:") ? key.substr(4) : key) << '#' << size;
+  return disk_key.str();
+}
+
+// Called with cache_mutex held
+void evict_over_budget()
+{
+  while(cache_bytes > cache_budget && !use_order.empty())
+  {
+    std::map<std::string, cache_entry>::iterator entry = entries.find(use_order.back());
+    cache_bytes -= entry->second.image->memory();
+    entries.erase(entry);
+    use_order.pop_back();
+    ++evictions;
+  }
+}
+
+void run_decoder()
+{
+  for(;;)
+  {
+    boost::unique_lock<boost::mutex> lock(cache_mutex);
+    while(decode_queue.empty() && !stopping_decoders)
+      queued_condition.wait(lock);
+    if(stopping_decoders)
+      return;
+    decode_job job = decode_queue.front();
+    decode_queue.pop_front();
+    lock.unlock();
+
+    boost::shared_ptr<decoded_image const> image;
+    try
+    {
+      image = load_cached_image(job.file, job.min_width, job.min_height, true);
+    }
+    catch(std::exception const& e)
+    {
+      std::cout << "Could not decode " << job.file.source_uri() << ": " << e.what() << std::endl;
+      continue;
+    }
+
+    if(job.ready)
+    {
+      decoded_delivery const delivery = {image, job.ready};
+      {
+        boost::lock_guard<boost::mutex> delivery_lock(delivery_mutex);
+        deliveries.push_back(delivery);
+      }
+      async_redraw();
+    }
+  }
+}
+
+// Called with cache_mutex held
+void start_decoders()
+{
+  if(!decoders_started)
+  {
+    std::size_t threads = boost::thread::hardware_concurrency();
+    if(!threads)
+      threads = 2;
+    for(std::size_t i = 0; i != threads; ++i)
+      decode_threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(&run_decoder)));
+    decoders_started = true;
+    // Joined before the state they wait on is destroyed, however the
+    // program ends
+    static bool stop_registered = false;
+    if(!stop_registered)
+    {
+      std::atexit(&stop_image_prefetch);
+      stop_registered = true;
+    }
+  }
+  queued_condition.notify_all();
+}
+
+}
+
+bool software_decodable(std::string const& source)
+{
+#ifndef GHTV_USE_OPENMAX
+  if(boost::algorithm::iends_with(source, ".png")
+     || boost::algorithm::iends_with(source, ".jpeg")
+     || boost::algorithm::iends_with(source, ".jpg"))
+    return true;
+#endif
+  return boost::algorithm::iends_with(source, ".gif");
+}
+
+boost::shared_ptr<decoded_image const> decode_image
+  (binary_file const& file, std::size_t min_width, std::size_t min_height, bool texture)
+{
+  scoped_stat_timer decode_timer(decode_time_stat);
+  std::string const& source = file.source_uri();
+  boost::shared_ptr<decoded_image> image(new decoded_image);
+  if(texture)
+  {
+    boost::shared_ptr<decoded_image const> const compressed
+      = sidecar_image(file, min_width, min_height);
+    if(compressed)
+      return compressed;
+  }
+
+  // JPEG has no alpha channel, other formats are scanned once decoded
+  bool known_opaque = false;
+  if(boost::algorithm::iends_with(source, ".gif"))
+  {
+    file_bytes bytes(file);
+    boost::shared_ptr<gif_frames const> frames
+      = load_gif_frames(bytes.data(), bytes.size(), composed_gif_budget);
+    gif_animation const first(frames);
+    image->width = frames->width;
+    image->height = frames->height;
+    image->rgba.assign(first.pixels(), first.pixels() + 4u * image->width * image->height);
+    if(frames->frames.size() > 1)
+      image->frames = frames;
+  }
+#ifndef GHTV_USE_OPENMAX
+  else if(boost::algorithm::iends_with(source, ".png"))
+    load_png_to_rgba(file, image->rgba, image->width, image->height);
+  else if(boost::algorithm::iends_with(source, ".jpeg") || boost::algorithm::iends_with(source, ".jpg"))
+  {
+    load_jpg_to_rgba(file, image->rgba, image->width, image->height, min_width, min_height);
+    known_opaque = true;
+  }
+#endif
+  else
+    throw std::runtime_error("File type not supported: " + source);
+  if(image->rgba.empty())
+    throw std::runtime_error("Could not decode image: " + source);
+
+  image->opaque = known_opaque || rgba_opaque(&image->rgba[0], image->width * image->height);
+  return image;
+}
+
+boost::shared_ptr<decoded_image const> load_cached_image
+  (binary_file const& file, std::size_t min_width, std::size_t min_height, bool texture)
+{
+  std::string const key = cache_key(file, min_width, min_height, texture);
+  boost::unique_lock<boost::mutex> lock(cache_mutex);
+  while(decoding.find(key) != decoding.end())
+    decoded_condition.wait(lock);
+
+  std::map<std::string, cache_entry>::iterator entry = entries.find(key);
+  if(entry != entries.end())
+  {
+    ++hits;
+    use_order.splice(use_order.begin(), use_order, entry->second.use);
+    return entry->second.image;
+  }
+
+  ++misses;
+  decoding.insert(key);
+  lock.unlock();
+  boost::shared_ptr<decoded_image const> image;
+  try
+  {
+    if(texture)
+      image = sidecar_image(file, min_width, min_height);
+    std::string const disk_key = image ? std::string() : disk_cache_key(file, key);
+    if(!disk_key.empty())
+      image = load_disk_cached_image(disk_key);
+    if(!image)
+    {
+      image = decode_image(file, min_width, min_height);
+      // Animations are decoded again, only their first frame is RGBA
+      if(!disk_key.empty() && !image->frames)
+        store_disk_cached_image(disk_key, *image);
+    }
+  }
+  catch(...)
+  {
+    lock.lock();
+    decoding.erase(key);
+    decoded_condition.notify_all();
+    throw;
+  }
+
+  lock.lock();
+  decoding.erase(key);
+  decoded_condition.notify_all();
+  if(image->memory() <= cache_budget)
+  {
+    use_order.push_front(key);
+    cache_entry& inserted = entries[key];
+    inserted.image = image;
+    inserted.use = use_order.begin();
+    cache_bytes += image->memory();
+    evict_over_budget();
+  }
+  return image;
+}
+
+boost::shared_ptr<decoded_image const> find_cached_image
+  (binary_file const& file, std::size_t min_width, std::size_t min_height, bool texture)
+{
+  std::string const key = cache_key(file, min_width, min_height, texture);
+  boost::lock_guard<boost::mutex> lock(cache_mutex);
+  std::map<std::string, cache_entry>::iterator entry = entries.find(key);
+  if(entry == entries.end())
+    return boost::shared_ptr<decoded_image const>();
+  ++hits;
+  use_order.splice(use_order.begin(), use_order, entry->second.use);
+  return entry->second.image;
+}
+
+void decode_image_async(binary_file const& file, std::size_t min_width, std::size_t min_height
+                        , image_ready_callback const& ready)
+{
+  boost::lock_guard<boost::mutex> lock(cache_mutex);
+  decode_queue.push_front(decode_job(file, min_width, min_height, ready));
+  start_decoders();
+}
+
+void deliver_decoded_images(std::size_t budget)
+{
+  std::size_t delivered = 0;
+  for(;;)
+  {
+    decoded_delivery delivery;
+    {
+      boost::lock_guard<boost::mutex> lock(delivery_mutex);
+      if(deliveries.empty())
+        return;
+      if(delivered && delivered + upload_size(*deliveries.front().image) > budget)
+      {
+        async_redraw();
+        return;
+      }
+      delivery = deliveries.front();
+      deliveries.pop_front();
+    }
+    delivered += upload_size(*delivery.image);
+    delivery.ready(delivery.image);
+  }
+}
+
+void set_compressed_texture_formats(std::vector<boost::uint32_t> const& formats)
+{
+  boost::lock_guard<boost::mutex> lock(cache_mutex);
+  compressed_formats = formats;
+}
+
+void set_image_cache_budget(std::size_t bytes)
+{
+  boost::lock_guard<boost::mutex> lock(cache_mutex);
+  cache_budget = bytes;
+  evict_over_budget();
+}
+
+void print_image_cache_statistics(std::ostream& os)
+{
+  boost::lock_guard<boost::mutex> lock(cache_mutex);
+  os << "image cache: " << entries.size() << " images, " << cache_bytes / 1024 << " of "
+     << cache_budget / 1024 << " KiB, " << hits << " hits, " << misses << " misses, "
+     << evictions << " evictions" << std::endl;
+  print_disk_image_cache_statistics(os);
+}
+
+void prefetch_images(std::string const& root, std::vector<image_source> const& sources)
+{
+  boost::lock_guard<boost::mutex> lock(cache_mutex);
+  for(std::vector<image_source>::const_iterator first = sources.begin()
+        , last = sources.end(); first != last; ++first)
+  {
+    if(software_decodable(first->source))
+      decode_queue.push_back(decode_job(binary_file(root, first->source), first->width
+                                        , first->height, image_ready_callback()));
+  }
+  start_decoders();
+}
+
+void stop_image_prefetch()
+{
+  std::vector<boost::shared_ptr<boost::thread> > threads;
+  {
+    boost::lock_guard<boost::mutex> lock(cache_mutex);
+    decode_queue.clear();
+    stopping_decoders = true;
+    queued_condition.notify_all();
+    threads.swap(decode_threads);
+  }
+  for(std::size_t i = 0; i != threads.size(); ++i)
+    threads[i]->join();
+  {
+    // Jobs queued meanwhile start a new pool
+    boost::lock_guard<boost::mutex> lock(cache_mutex);
+    decoders_started = false;
+    stopping_decoders = false;
+    if(!decode_queue.empty())
+      start_decoders();
+  }
+  boost::lock_guard<boost::mutex> lock(delivery_mutex);
+  deliveries.clear();
+}
+
+} } }
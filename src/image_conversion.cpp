@@ -0,0 +1,294 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/image_conversion.hpp>
+
+#include <boost/cstdint.hpp>
+
+#include <cstring>
+#include <cassert>
+
+// The vector kernels index bytes of little endian pixels, which is what
+// every x86 and almost every ARM runs
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#if defined(__SSSE3__)
+#define GHTV_SSSE3_FUNCTION
+#define GHTV_HAS_SSSE3
+#elif (defined(__i386__) || defined(__x86_64__)) \
+  && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+// Compiled for the baseline CPU: the SSSE3 kernels are built anyway and
+// picked at run time
+#define GHTV_SSSE3_FUNCTION __attribute__((target("ssse3")))
+#define GHTV_HAS_SSSE3
+#define GHTV_SSSE3_AT_RUNTIME
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GHTV_HAS_NEON
+#endif
+#endif
+
+#if defined(GHTV_HAS_SSSE3)
+#include <tmmintrin.h>
+#elif defined(GHTV_HAS_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+// Offsets, inside a source pixel, of the bytes that go out as the first,
+// second, third and fourth channel
+struct channel_order
+{
+  unsigned char c0, c1, c2, a;
+};
+
+// Cairo ARGB32 is a native endian 32-bit integer:
+// * little endian ..... BGRA
+// * big endian ........ ARGB
+channel_order const little_endian_to_rgba = {2, 1, 0, 3};
+channel_order const big_endian_to_rgba = {1, 2, 3, 0};
+channel_order const unchanged = {0, 1, 2, 3};
+
+bool is_little_endian()
+{
+  // if 0x01 is the first byte the machine is little endian
+  long multibyte_integer = 1;
+  return ((char*)&multibyte_integer)[0] != 0;
+}
+
+// 16.16 fixed point 255/alpha, rounded, so that un-premultiplying is a
+// multiplication instead of a division
+struct reciprocal_table
+{
+  reciprocal_table()
+  {
+    values[0] = 0;
+    for(boost::uint32_t alpha = 1; alpha != 256; ++alpha)
+      values[alpha] = ((255u << 16) + alpha/2) / alpha;
+  }
+
+  boost::uint32_t values[256];
+};
+
+reciprocal_table const reciprocals;
+
+inline unsigned char unpremultiply(unsigned char color, unsigned char alpha)
+{
+  boost::uint32_t const value = (color * reciprocals.values[alpha] + 0x8000) >> 16;
+  return value > 0xFF ? 0xFF : value;
+}
+
+void swizzle_scalar(unsigned char const* src, unsigned char* dest, std::size_t pixels
+                    , channel_order const& order)
+{
+  for(unsigned char const* last = src + 4*pixels; src != last; src += 4, dest += 4)
+  {
+    dest[0] = src[order.c0];
+    dest[1] = src[order.c1];
+    dest[2] = src[order.c2];
+    dest[3] = src[order.a];
+  }
+}
+
+void unpremultiply_scalar(unsigned char const* src, unsigned char* dest, std::size_t pixels
+                          , channel_order const& order)
+{
+  for(unsigned char const* last = src + 4*pixels; src != last; src += 4, dest += 4)
+  {
+    unsigned char const alpha = src[order.a];
+    dest[3] = alpha;
+    // Premultiplied transparent pixels are already all zero
+    if(alpha == 0xFF || alpha == 0)
+    {
+      dest[0] = src[order.c0];
+      dest[1] = src[order.c1];
+      dest[2] = src[order.c2];
+    }
+    else
+    {
+      dest[0] = unpremultiply(src[order.c0], alpha);
+      dest[1] = unpremultiply(src[order.c1], alpha);
+      dest[2] = unpremultiply(src[order.c2], alpha);
+    }
+  }
+}
+
+#if defined(GHTV_HAS_SSSE3)
+
+// The pshufb control that moves the bytes of four pixels to @p order
+GHTV_SSSE3_FUNCTION
+inline __m128i shuffle_mask(channel_order const& order)
+{
+  return _mm_setr_epi8(order.c0, order.c1, order.c2, order.a
+                       , 4 + order.c0, 4 + order.c1, 4 + order.c2, 4 + order.a
+                       , 8 + order.c0, 8 + order.c1, 8 + order.c2, 8 + order.a
+                       , 12 + order.c0, 12 + order.c1, 12 + order.c2, 12 + order.a);
+}
+
+GHTV_SSSE3_FUNCTION
+void swizzle_ssse3(unsigned char const* src, unsigned char* dest, std::size_t pixels
+                   , channel_order const& order)
+{
+  __m128i const mask = shuffle_mask(order);
+  std::size_t i = 0;
+  for(; i + 4 <= pixels; i += 4)
+  {
+    __m128i const four = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 4*i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 4*i), _mm_shuffle_epi8(four, mask));
+  }
+  swizzle_scalar(src + 4*i, dest + 4*i, pixels - i, order);
+}
+
+// Text and rendered HTML are mostly transparent background and opaque
+// glyphs: only groups with a partially transparent pixel take the scalar
+// division
+GHTV_SSSE3_FUNCTION
+void unpremultiply_ssse3(unsigned char const* src, unsigned char* dest, std::size_t pixels
+                         , channel_order const& order)
+{
+  __m128i const mask = shuffle_mask(order);
+  __m128i const alpha_mask = _mm_slli_epi32(_mm_set1_epi32(0xFF), 8 * order.a);
+  __m128i const zero = _mm_setzero_si128();
+  std::size_t i = 0;
+  for(; i + 4 <= pixels; i += 4)
+  {
+    __m128i const four = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 4*i));
+    __m128i const alpha = _mm_and_si128(four, alpha_mask);
+    // Every byte compares equal when the alphas are all 255, or all 0
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(alpha, alpha_mask)) == 0xFFFF
+       || _mm_movemask_epi8(_mm_cmpeq_epi8(alpha, zero)) == 0xFFFF)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 4*i), _mm_shuffle_epi8(four, mask));
+    else
+      unpremultiply_scalar(src + 4*i, dest + 4*i, 4, order);
+  }
+  unpremultiply_scalar(src + 4*i, dest + 4*i, pixels - i, order);
+}
+
+#elif defined(GHTV_HAS_NEON)
+
+// vld4 splits sixteen pixels into one register per byte position, so the
+// swizzle is only a matter of which registers vst4 writes back, where the
+// SSSE3 kernels need a table lookup
+inline uint8x16x4_t reorder(uint8x16x4_t const& planes, channel_order const& order)
+{
+  uint8x16x4_t result;
+  result.val[0] = planes.val[order.c0];
+  result.val[1] = planes.val[order.c1];
+  result.val[2] = planes.val[order.c2];
+  result.val[3] = planes.val[order.a];
+  return result;
+}
+
+void swizzle_neon(unsigned char const* src, unsigned char* dest, std::size_t pixels
+                  , channel_order const& order)
+{
+  std::size_t i = 0;
+  for(; i + 16 <= pixels; i += 16)
+    vst4q_u8(dest + 4*i, reorder(vld4q_u8(src + 4*i), order));
+  swizzle_scalar(src + 4*i, dest + 4*i, pixels - i, order);
+}
+
+void unpremultiply_neon(unsigned char const* src, unsigned char* dest, std::size_t pixels
+                        , channel_order const& order)
+{
+  std::size_t i = 0;
+  for(; i + 16 <= pixels; i += 16)
+  {
+    uint8x16x4_t const planes = vld4q_u8(src + 4*i);
+    uint8x16_t const alpha = planes.val[order.a];
+    uint8x8_t const all = vand_u8(vget_low_u8(alpha), vget_high_u8(alpha));
+    uint8x8_t const any = vorr_u8(vget_low_u8(alpha), vget_high_u8(alpha));
+    if(vget_lane_u64(vreinterpret_u64_u8(all), 0) == ~boost::uint64_t(0)
+       || vget_lane_u64(vreinterpret_u64_u8(any), 0) == 0)
+      vst4q_u8(dest + 4*i, reorder(planes, order));
+    else
+      unpremultiply_scalar(src + 4*i, dest + 4*i, 16, order);
+  }
+  unpremultiply_scalar(src + 4*i, dest + 4*i, pixels - i, order);
+}
+
+#endif
+
+typedef void (*row_function)(unsigned char const*, unsigned char*, std::size_t
+                             , channel_order const&);
+
+struct kernels
+{
+  kernels()
+    : swizzle(&swizzle_scalar), unpremultiply(&unpremultiply_scalar)
+  {
+#if defined(GHTV_HAS_SSSE3)
+#if defined(GHTV_SSSE3_AT_RUNTIME)
+    __builtin_cpu_init();
+    if(!__builtin_cpu_supports("ssse3"))
+      return;
+#endif
+    swizzle = &swizzle_ssse3;
+    unpremultiply = &unpremultiply_ssse3;
+#elif defined(GHTV_HAS_NEON)
+    swizzle = &swizzle_neon;
+    unpremultiply = &unpremultiply_neon;
+#endif
+  }
+
+  row_function swizzle, unpremultiply;
+};
+
+kernels const& selected_kernels()
+{
+  static kernels const selected;
+  return selected;
+}
+
+void convert_rows(void* data, int width, int height, int stride
+                  , std::vector<unsigned char>& output
+                  , row_function convert_row, channel_order const& order)
+{
+  std::size_t const line_size = 4 * std::size_t(width);
+  output.resize(line_size * height);
+  if(output.empty())
+    return;
+
+  unsigned char const* src = static_cast<unsigned char const*>(data);
+  for(int y = 0; y != height; ++y, src += stride)
+    convert_row(src, &output[y * line_size], width, order);
+}
+
+}
+
+void rgba_from_cairo_ARGB32(void* data, int width, int height, int stride, std::vector<unsigned char>& output)
+{
+  convert_rows(data, width, height, stride, output, selected_kernels().swizzle
+               , is_little_endian() ? little_endian_to_rgba : big_endian_to_rgba);
+}
+
+void unpremultiplied_rgba_from_cairo_ARGB32(void* data, int width, int height, int stride
+                                            , std::vector<unsigned char>& output)
+{
+  convert_rows(data, width, height, stride, output, selected_kernels().unpremultiply
+               , is_little_endian() ? little_endian_to_rgba : big_endian_to_rgba);
+}
+
+void unpremultiplied_bgra_from_cairo_ARGB32(void* data, int width, int height, int stride
+                                            , std::vector<unsigned char>& output)
+{
+  assert(is_little_endian());
+  convert_rows(data, width, height, stride, output, selected_kernels().unpremultiply
+               , unchanged);
+}
+
+} } }
@@ -0,0 +1,147 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/ktx.hpp>
+
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+unsigned char const identifier[12]
+  = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+boost::uint32_t const endianness = 0x04030201;
+boost::uint32_t const swapped_endianness = 0x01020304;
+
+// Fields of the header, after the identifier, in file order
+enum header_field
+{
+  endianness_field, gl_type_field, gl_type_size_field, gl_format_field
+  , gl_internal_format_field, gl_base_internal_format_field
+  , pixel_width_field, pixel_height_field, pixel_depth_field
+  , array_elements_field, faces_field, mipmap_levels_field, key_value_bytes_field
+  , header_field_count
+};
+
+std::size_t const header_size = sizeof(identifier) + 4 * header_field_count;
+
+boost::uint32_t const gl_rgb = 0x1907;
+boost::uint32_t const gl_rgba = 0x1908;
+
+boost::uint32_t swap_bytes(boost::uint32_t value)
+{
+  return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+}
+
+boost::uint32_t read_word(unsigned char const* bytes, bool swap)
+{
+  boost::uint32_t value;
+  std::memcpy(&value, bytes, 4);
+  return swap ? swap_bytes(value) : value;
+}
+
+void write_word(std::ostream& os, boost::uint32_t value)
+{
+  os.write(reinterpret_cast<char const*>(&value), 4);
+}
+
+}
+
+std::size_t compressed_size(boost::uint32_t format, std::size_t width, std::size_t height)
+{
+  std::size_t const blocks = ((width + 3) / 4) * ((height + 3) / 4);
+  switch(format)
+  {
+  case etc1_rgb8_format:
+  case etc2_rgb8_format:
+    return blocks * 8;
+  case etc2_rgba8_eac_format:
+    return blocks * 16;
+  default:
+    return 0;
+  }
+}
+
+std::string ktx_sidecar_path(std::string const& image)
+{
+  return image + ".ktx";
+}
+
+void load_ktx(unsigned char const* bytes, std::size_t size, compressed_image& image)
+{
+  if(size < header_size || std::memcmp(bytes, identifier, sizeof(identifier)))
+    throw std::runtime_error("Not a KTX file");
+
+  unsigned char const* fields = bytes + sizeof(identifier);
+  boost::uint32_t const order = read_word(fields, false);
+  if(order != endianness && order != swapped_endianness)
+    throw std::runtime_error("KTX file of unknown endianness");
+  bool const swap = order == swapped_endianness;
+
+  boost::uint32_t header[header_field_count];
+  for(std::size_t i = 0; i != header_field_count; ++i)
+    header[i] = read_word(fields + 4*i, swap);
+
+  image.format = header[gl_internal_format_field];
+  image.width = header[pixel_width_field];
+  image.height = header[pixel_height_field];
+  std::size_t const expected = compressed_size(image.format, image.width, image.height);
+  if(header[gl_type_field] != 0 || !expected)
+    throw std::runtime_error("KTX file is not ETC compressed");
+  if(header[pixel_depth_field] > 1 || header[array_elements_field] > 1
+     || header[faces_field] > 1)
+    throw std::runtime_error("KTX file is not a 2D texture");
+
+  // Compressed blocks keep every mipmap level 4 byte aligned, the
+  // image size is all there is between levels. Sizes from the file are
+  // compared with what is left, so no sum can wrap around
+  std::size_t const key_value_bytes = header[key_value_bytes_field];
+  if(key_value_bytes > size - header_size || size - header_size - key_value_bytes < 4)
+    throw std::runtime_error("Truncated KTX file");
+  std::size_t const offset = header_size + key_value_bytes;
+  std::size_t const level_size = read_word(bytes + offset, swap);
+  if(level_size != expected || level_size > size - offset - 4)
+    throw std::runtime_error("Truncated KTX file");
+  image.data.assign(bytes + offset + 4, bytes + offset + 4 + level_size);
+}
+
+void write_ktx(std::string const& path, compressed_image const& image)
+{
+  std::ofstream os(path.c_str(), std::ios::binary);
+  os.write(reinterpret_cast<char const*>(identifier), sizeof(identifier));
+
+  boost::uint32_t header[header_field_count] = {0};
+  header[endianness_field] = endianness;
+  header[gl_type_size_field] = 1;
+  header[gl_internal_format_field] = image.format;
+  header[gl_base_internal_format_field] = image.opaque() ? gl_rgb : gl_rgba;
+  header[pixel_width_field] = image.width;
+  header[pixel_height_field] = image.height;
+  header[faces_field] = 1;
+  header[mipmap_levels_field] = 1;
+  for(std::size_t i = 0; i != header_field_count; ++i)
+    write_word(os, header[i]);
+
+  write_word(os, image.data.size());
+  os.write(reinterpret_cast<char const*>(&image.data[0]), image.data.size());
+  if(!os.flush())
+    throw std::runtime_error("Could not write " + path);
+}
+
+} } }
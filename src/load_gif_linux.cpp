@@ -14,22 +14,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <boost/concept_check.hpp>
-
-#define GL_GLEXT_PROTOTYPES
-
-#ifdef GHTV_USE_GLUT
-#include <GL/glut.h>
-#endif
-#ifdef GHTV_USE_OPENGLES2
-#include <GLES2/gl2.h>
-#include <GLES2/gl2ext.h>
-#endif
-#include <EGL/egl.h>
-#include <EGL/eglext.h>
-
 #include <ghtv/opengl/linux/load_gif.hpp>
-#include <ghtv/opengl/linux/binary_file.hpp>
+#include <ghtv/opengl/linux/palette_expand.hpp>
 
 #include <gif_lib.h>
 
@@ -44,15 +30,14 @@ namespace ghtv { namespace opengl { namespace linux_ {
 
 namespace {
 
+// Reads straight from the borrowed file content
 struct GifFile
 {
-  GifFile(binary_file const& file)
+  GifFile(unsigned char const* bytes, std::size_t size)
     : m_handle()
-    , m_binary_file(file)
-    , m_mem_stream()
+    , m_mem_stream(bytes)
+    , m_mem_end(bytes + size)
   {
-    m_binary_file.load_content();
-    m_mem_stream = &(m_binary_file.file_content()[0]);
 
 #if defined(GIFLIB_MAJOR) && GIFLIB_MAJOR >= 5
     int error_code = 0;
@@ -61,7 +46,7 @@ struct GifFile
     m_handle = DGifOpen(this, gif_input_func);
 #endif
     if(!m_handle) {
-      throw std::runtime_error("Could not open " + m_binary_file.source_uri());
+      throw std::runtime_error("Could not open gif file");
     }
   }
 
@@ -96,6 +81,8 @@ struct GifFile
 
   int read(GifByteType* bytes, int size)
   {
+    if(size > m_mem_end - m_mem_stream)
+      size = int(m_mem_end - m_mem_stream);
     std::memcpy(bytes, m_mem_stream, size);
     m_mem_stream += size;
     return size;
@@ -110,8 +97,8 @@ struct GifFile
 
 private:
   GifFileType* m_handle;
-  binary_file m_binary_file;
-  char const* m_mem_stream;
+  unsigned char const* m_mem_stream;
+  unsigned char const* m_mem_end;
 };
 
 void amend_errors_or_throw(GifFileType* gif_file)
@@ -123,266 +110,217 @@ void amend_errors_or_throw(GifFileType* gif_file)
   }
 }
 
-void get_screen_from_first_image(
-  GifFileType* gif_file
-, std::vector<unsigned char>& screen_pixels)
-{
-  GifWord swidth = gif_file->SWidth;
-  GifWord sheight = gif_file->SHeight;
-  std::size_t ssize = (std::size_t)(swidth * sheight);
-
-  screen_pixels.clear();
-
-  if(swidth == 0 || sheight == 0)
-  {
-    std::cerr << "Zero pixels gif screen... Nothing to do..." << std::endl;
-    return;
-  }
-
-  // Allocate pixels
-  screen_pixels.resize(ssize);
+int const graphics_control_extension = 0xF9;
 
-  // Creating matrix to read the gif pixels
-  std::vector<GifRowType> row_vec(sheight);
-  GifRowType* screen_buffer = &row_vec[0];
-  for(int y = 0; y < sheight; ++y)
+#if !defined(GIFLIB_MAJOR) || GIFLIB_MAJOR < 5
+// Rows of an interlaced image are stored every 8th from 0, every 8th
+// from 4, every 4th from 2 and then every 2nd from 1
+void deinterlace(std::vector<unsigned char>& indices, int width, int height)
+{
+  int const offsets[] = { 0, 4, 2, 1 };
+  int const jumps[] = { 8, 8, 4, 2 };
+  std::vector<unsigned char> rows(indices.size());
+  unsigned char const* source = &indices[0];
+  for(int pass = 0; pass != 4; ++pass)
   {
-    screen_buffer[y] = &screen_pixels[0] + (y * swidth);
+    for(int y = offsets[pass]; y < height; y += jumps[pass], source += width)
+      std::memcpy(&rows[std::size_t(y) * width], source, width);
   }
+  indices.swap(rows);
+}
 
-  GifRecordType record = TERMINATE_RECORD_TYPE;
-  bool got_image = false;
-
-  do {
-    if(DGifGetRecordType(gif_file, &record) == GIF_ERROR) {
-      throw std::runtime_error("Could not parse gif file");
-    }
-    switch (record){
-    case IMAGE_DESC_RECORD_TYPE:
-    {
-      // TODO this function does useless work... optmize it?
-      if(DGifGetImageDesc(gif_file) == GIF_ERROR)
-      {
-        throw std::runtime_error("Could not parse gif file");
-      }
-
-      GifWord Row = gif_file->Image.Top;
-      GifWord Col = gif_file->Image.Left;
-      GifWord Width = gif_file->Image.Width;
-      GifWord Height = gif_file->Image.Height;
-
-      std::cout << "Image at (" << Col << "," << Row << ") [" << Width << "x" << Height << "]" <<  std::endl;
-
-      if(Col + Width > swidth || Col < 0 ||
-         Row + Height > sheight || Row < 0)
-      {
-        throw std::runtime_error("Image is not confined to screen dimension");
-      }
-
-      if(Width == 0 || Height == 0)
-      {
-        std::cerr << "Zero pixels gif frame... Returning to paint background..." << std::endl;
-        return;
-      }
+#endif
 
-      // TODO Shouldn't this be handled by the giflib?
-      if(gif_file->Image.Interlace)
-      {
-        const int InterlacedOffset[] = { 0, 4, 2, 1 }; // The way Interlaced image should
-        const int InterlacedJumps[] = { 8, 8, 4, 2 };  // be read - offsets and jumps...
-        // Need to perform 4 passes on the images:
-        for(int i = 0; i < 4; ++i)
-        {
-          for(int y = Row + InterlacedOffset[i]; y < Row + Height; y += InterlacedJumps[i])
-          {
-            if(DGifGetLine(gif_file, &screen_buffer[y][Col], Width) == GIF_ERROR)
-            {
-              throw std::runtime_error("Could not parse gif file");
-            }
-          }
-        }
-      }
-      else
-      {
-        int Row_it = Row;
-        for(int y = 0; y < Height; ++y)
-        {
-          if (DGifGetLine(gif_file, &screen_buffer[Row_it++][Col], Width) == GIF_ERROR)
-          {
-            throw std::runtime_error("Could not parse gif file");
-          }
-        }
-      }
-      got_image = true;
-      break;
-    }
-    case EXTENSION_RECORD_TYPE:
-    {
-      // TODO Transparent index
-      // TODO Plain text image???
-      /* Skip any extension blocks in file: */
-      int ExtCode;
-      GifByteType *Extension;
-
-      // TODO Probaly unnecessary memory allocations are being done here. Check it!!!
-      if (DGifGetExtension(gif_file, &ExtCode, &Extension) == GIF_ERROR)
-      {
-        throw std::runtime_error("Could not parse gif file");
-      }
+// Clips the rectangle of @p frame to the logical screen
+bool clip_frame(gif_frame const& frame, std::size_t width, std::size_t height
+                , int& x0, int& y0, int& x1, int& y1)
+{
+  x0 = (std::max)(frame.left, 0);
+  y0 = (std::max)(frame.top, 0);
+  x1 = (std::min)(frame.left + frame.width, int(width));
+  y1 = (std::min)(frame.top + frame.height, int(height));
+  return x0 < x1 && y0 < y1
+    && frame.indices.size() >= std::size_t(frame.width) * frame.height;
+}
 
-      // TODO Here too!!!
-      while (Extension != NULL)
-      {
-        if (DGifGetExtensionNext(gif_file, &Extension) == GIF_ERROR)
-        {
-          throw std::runtime_error("Could not parse gif file");
-        }
-      }
-      break;
-    }
-    case TERMINATE_RECORD_TYPE:
-      break;
-    default:
-      break;
-    }
-  } while(!got_image && record != TERMINATE_RECORD_TYPE);
+// Applies the disposal of @p frame to the canvas, before the next frame
+// is drawn. @p saved holds what was under it if it restores the previous
+// pixels.
+void dispose_frame(gif_frame const& frame, std::size_t width, std::size_t height
+                   , std::vector<unsigned char>& canvas, std::vector<unsigned char> const& saved)
+{
+  int x0, y0, x1, y1;
+  if((frame.disposal != 2 && frame.disposal != 3)
+     || !clip_frame(frame, width, height, x0, y0, x1, y1))
+    return;
 
-  if(!got_image)
+  for(int y = y0; y != y1; ++y)
   {
-    std::cerr << "Gif file does not contain any valid images. Nothing to do..." << std::endl;
+    unsigned char* row = &canvas[4u * (y * width + x0)];
+    if(frame.disposal == 2)
+      // The background is transparent, as in browsers
+      fill_rgba(row, x1 - x0, 0);
+    else
+      std::memcpy(row, &saved[4u * ((y - y0) * (x1 - x0))], 4u * (x1 - x0));
   }
 }
 
-void screen_to_rgba(
-  GifFileType const* gif_file
-, std::vector<unsigned char> const& screen_pixels
-, std::vector<unsigned char>& rgba_out)
+void draw_frame(gif_frame const& frame, std::size_t width, std::size_t height
+                , std::vector<unsigned char>& canvas, std::vector<unsigned char>& saved)
 {
-  ColorMapObject *color_map = ( gif_file->Image.ColorMap ? gif_file->Image.ColorMap
-                              : gif_file->SColorMap);
-  // TODO create a default pallete
-  if(!color_map)
+  int x0, y0, x1, y1;
+  if(!clip_frame(frame, width, height, x0, y0, x1, y1))
+    return;
+
+  if(frame.disposal == 3)
   {
-    throw std::runtime_error("gif image does not contain a color pallete");
+    saved.resize(4u * (x1 - x0) * (y1 - y0));
+    for(int y = y0; y != y1; ++y)
+      std::memcpy(&saved[4u * ((y - y0) * (x1 - x0))]
+                  , &canvas[4u * (y * width + x0)], 4u * (x1 - x0));
   }
 
-  GifWord swidth = gif_file->SWidth;
-  GifWord sheight = gif_file->SHeight;
-
-  GifWord left = gif_file->Image.Left;
-  GifWord top = gif_file->Image.Top;
-  GifWord width = gif_file->Image.Width;
-  GifWord height = gif_file->Image.Height;
-
-  // GIF89a Specification does not cover what to set the background to when
-  // there is no global pallete.
-  // Setting the background to transparency.
-
-  // Creating RGBA buffer and filling it with colors from the gif pallete
-  rgba_out.assign(4u * screen_pixels.size(),  0);
-
-  // TODO render all images in the canvas (for "picture wall" like images)
-  // TODO Pixel aspect ratio
-  // TODO transparent index
-  for(int y = top; y < top+height; ++y)
+  for(int y = y0; y != y1; ++y)
   {
-    unsigned char* rgba_row = &rgba_out[0] + (y * 4u * swidth);
-    unsigned char const* screen_row = &screen_pixels[0] + (y * swidth);
-    for(int x = left; x < left+width; ++x)
-    {
-      GifColorType* ColorMapEntry = &color_map->Colors[screen_row[x]];
-
-      unsigned char* rgba_pixel = rgba_row + (4u * x);
-      rgba_pixel[0] = ColorMapEntry->Red;
-      rgba_pixel[1] = ColorMapEntry->Green;
-      rgba_pixel[2] = ColorMapEntry->Blue;
-      rgba_pixel[3] = 0xff; // 100% opaque pixel
-    }
+    unsigned char const* indices = &frame.indices[std::size_t(y - frame.top) * frame.width
+                                                  + (x0 - frame.left)];
+    expand_palette_over(indices, x1 - x0, &frame.colors[0], &canvas[4u * (y * width + x0)]);
   }
+}
 
-  // Filling background pixels with the global pallete color
-  if(gif_file->SColorMap &&
-    (left != 0 || top != 0 || width != swidth || height != sheight)
-  ){
-    // TODO Optmize it!!!
-    // It is visiting unnecessary pixels and doing many comparisons.
-    GifColorType* bg_color = &gif_file->SColorMap->Colors[gif_file->SBackGroundColor];
-    for(int y = 0; y < sheight; ++y)
-    {
-      unsigned char* rgba_row = &rgba_out[0] + (y * 4u * swidth);
-      for(int x = 0; x < swidth; ++x)
-      {
-        if(y >= top && y < top+height && x >= left && x < left+width)
-          continue;
-
-        unsigned char* rgba_pixel = rgba_row + (4u * x);
-        rgba_pixel[0] = bg_color->Red;
-        rgba_pixel[1] = bg_color->Green;
-        rgba_pixel[2] = bg_color->Blue;
-        rgba_pixel[3] = 0xff; // 100% opaque pixel
-      }
-    }
-  }
+// Turns the canvas holding the frame before @p i into frame @p i
+void compose_frame(gif_frames const& gif, std::size_t i
+                   , std::vector<unsigned char>& canvas, std::vector<unsigned char>& saved)
+{
+  if(i == 0)
+    canvas.assign(4u * gif.width * gif.height, 0);
+  else
+    dispose_frame(gif.frames[i - 1], gif.width, gif.height, canvas, saved);
+  draw_frame(gif.frames[i], gif.width, gif.height, canvas, saved);
 }
 
 } // end of anonymous namespace
 
-void load_gif_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height)
+std::size_t gif_frames::memory() const
+{
+  std::size_t bytes = 0;
+  for(std::vector<gif_frame>::const_iterator first = frames.begin(), last = frames.end()
+        ; first != last; ++first)
+    bytes += first->indices.size() + 4u * first->colors.size();
+  for(std::size_t i = 0; i != composed.size(); ++i)
+    bytes += composed[i].size();
+  return bytes;
+}
+
+boost::shared_ptr<gif_frames const> load_gif_frames
+  (unsigned char const* bytes, std::size_t size, std::size_t composed_budget)
 {
-  GifFile gif_file(file);
+  GifFile gif_file(bytes, size);
 
   amend_errors_or_throw(gif_file);
+  if(DGifSlurp(gif_file) == GIF_ERROR)
+    throw std::runtime_error("Could not parse gif file");
 
-  std::vector<unsigned char> screen_pixels;
-  get_screen_from_first_image(gif_file, screen_pixels);
+  boost::shared_ptr<gif_frames> gif(new gif_frames);
+  gif->width = std::size_t((std::max)(gif_file->SWidth, 0));
+  gif->height = std::size_t((std::max)(gif_file->SHeight, 0));
+  if(!gif->width || !gif->height || gif_file->ImageCount <= 0)
+    throw std::runtime_error("Gif file does not contain any images");
 
-  if(screen_pixels.size() ==  0)
+  gif->frames.resize(gif_file->ImageCount);
+  for(int i = 0; i != gif_file->ImageCount; ++i)
   {
-    return;
-  }
+    SavedImage const& image = gif_file->SavedImages[i];
+    gif_frame& frame = gif->frames[i];
+    frame.left = image.ImageDesc.Left;
+    frame.top = image.ImageDesc.Top;
+    frame.width = image.ImageDesc.Width;
+    frame.height = image.ImageDesc.Height;
+    frame.disposal = 0;
+    frame.delay_ms = 100;
+    int transparent = -1;
+
+    for(int e = 0; e != image.ExtensionBlockCount; ++e)
+    {
+      ExtensionBlock const& block = image.ExtensionBlocks[e];
+      if(block.Function != graphics_control_extension || block.ByteCount < 4)
+        continue;
+      unsigned char const* data = reinterpret_cast<unsigned char const*>(block.Bytes);
+      frame.disposal = (data[0] >> 2) & 0x07;
+      if(data[0] & 0x01)
+        transparent = data[3];
+      unsigned int const delay = 10u * (data[1] | (data[2] << 8));
+      // Browsers slow down delays this short, and banners count on it
+      frame.delay_ms = delay < 20 ? 100 : delay;
+    }
 
-  screen_to_rgba(gif_file, screen_pixels, data);
+    std::vector<unsigned char> rgb;
+    if(ColorMapObject const* color_map = image.ImageDesc.ColorMap
+       ? image.ImageDesc.ColorMap : gif_file->SColorMap)
+    {
+      for(int c = 0; c != color_map->ColorCount && c != int(palette_size); ++c)
+      {
+        rgb.push_back(color_map->Colors[c].Red);
+        rgb.push_back(color_map->Colors[c].Green);
+        rgb.push_back(color_map->Colors[c].Blue);
+      }
+    }
+    frame.colors.resize(palette_size);
+    make_palette_lut(rgb.empty() ? 0 : &rgb[0], rgb.size() / 3, transparent, &frame.colors[0]);
 
-  width = (std::size_t)(gif_file->SWidth);
-  height = (std::size_t)(gif_file->SHeight);
+    if(image.RasterBits && frame.width > 0 && frame.height > 0)
+    {
+      frame.indices.assign(image.RasterBits
+                           , image.RasterBits + std::size_t(frame.width) * frame.height);
+#if !defined(GIFLIB_MAJOR) || GIFLIB_MAJOR < 5
+      // giflib 5 already deinterlaces in DGifSlurp
+      if(image.ImageDesc.Interlace)
+        deinterlace(frame.indices, frame.width, frame.height);
+#endif
+    }
+  }
 
-  // TODO Is it OK to close the file without reading it entirely?
-  if(!gif_file.close())
+  std::size_t const frame_bytes = 4u * gif->width * gif->height;
+  if(gif->frames.size() * frame_bytes <= composed_budget)
   {
-    throw std::runtime_error("Could not close gif file");
+    std::vector<unsigned char> canvas, saved;
+    gif->composed.resize(gif->frames.size());
+    for(std::size_t i = 0; i != gif->frames.size(); ++i)
+    {
+      compose_frame(*gif, i, canvas, saved);
+      gif->composed[i] = canvas;
+    }
   }
+  return gif;
 }
 
-
-texture load_gif(binary_file const& file)
+gif_animation::gif_animation(boost::shared_ptr<gif_frames const> const& frames)
+  : frames(frames), current(0), canvas(), saved()
 {
-  std::cout << "load_gif " << file.source_uri() << std::endl;
-
-  std::vector<unsigned char> data;
-  std::size_t width = 0;
-  std::size_t height = 0;
-
-  opengl::texture texture;
-  load_gif_to_rgba(file, data, width, height);
-  if(data.size() == 0)
-    return texture;
-
-  glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
-  texture.bind();
-
-  std::cout << "width " << width << " height " << height << std::endl;
+  if(frames->composed.empty())
+    compose_frame(*frames, 0, canvas, saved);
+}
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA
-                , GL_UNSIGNED_BYTE, &data[0]);
+unsigned char const* gif_animation::pixels() const
+{
+  return frames->composed.empty() ? &canvas[0] : &frames->composed[current][0];
+}
 
-  assert(glGetError() == GL_NO_ERROR);
+unsigned int gif_animation::delay_ms() const
+{
+  return frames->frames[current].delay_ms;
+}
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  assert(glGetError() == GL_NO_ERROR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  assert(glGetError() == GL_NO_ERROR);
+void gif_animation::advance()
+{
+  current = (current + 1) % frames->frames.size();
+  if(frames->composed.empty())
+    compose_frame(*frames, current, canvas, saved);
+}
 
-  return texture;
+std::size_t gif_animation::memory() const
+{
+  return frames->memory() + canvas.capacity() + saved.capacity();
 }
 
 } } }
@@ -14,102 +14,327 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifdef GHTV_USE_GLUT
-#include <GL/glut.h>
-#endif
-#ifdef GHTV_USE_OPENGLES2
-#include <GLES2/gl2.h>
-#include <GLES2/gl2ext.h>
-#endif
-
 #include <ghtv/opengl/linux/load_jpg.hpp>
 
 #include <jpeglib.h>
+#include <jerror.h>
 
 #include <cstdio>
 #include <cstring>
+#include <csetjmp>
+#include <algorithm>
 #include <vector>
+#include <string>
+#include <stdexcept>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
-//
-//  TODO proper error handling
-//
+namespace {
 
-void load_jpg_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height)
+// The smallest M/8 scale the library can decode at that is not smaller
+// than the requested size, 8 for full size. IDCT scaling is much cheaper
+// than decoding at full size and scaling afterwards.
+unsigned int scale_numerator(std::size_t width, std::size_t height
+                             , std::size_t min_width, std::size_t min_height)
 {
-  // Load JPEG file
-  binary_file temp_file = file;
-  temp_file.load_content();
-  std::vector<char> const& c = temp_file.file_content();
+  if(!min_width || !min_height)
+    return 8;
 
-  struct jpeg_decompress_struct cinfo;
-  struct jpeg_error_mgr jerr;
-
-  // Set up decompression structure and error stream.
-  cinfo.err = jpeg_std_error(&jerr);
-  jpeg_create_decompress(&cinfo);
+  for(unsigned int num = 1; num != 8; ++num)
+  {
+#if JPEG_LIB_VERSION < 70
+    // Older libraries only scale by 1/1, 1/2, 1/4 and 1/8
+    if(num & (num - 1))
+      continue;
+#endif
+    if((width * num + 7) / 8 >= min_width && (height * num + 7) / 8 >= min_height)
+      return num;
+  }
+  return 8;
+}
 
-  // Set input memory buffer
-  jpeg_mem_src(&cinfo, (unsigned char*)&c[0], c.size());
+void choose_scale(jpeg_decompress_struct& cinfo, std::size_t min_width, std::size_t min_height)
+{
+  cinfo.scale_num = scale_numerator(cinfo.image_width, cinfo.image_height, min_width, min_height);
+  cinfo.scale_denom = 8;
+}
 
-  // Read JPEG header
-  jpeg_read_header(&cinfo, TRUE);
+// Errors keep their message and longjmp to the reader that started the
+// call, which throws, instead of exiting the process
+struct error_manager
+{
+  jpeg_error_mgr manager;
+  std::jmp_buf jump;
+  std::string message;
+};
 
-  // Set the decompression color space to RGB
-  cinfo.out_color_space = JCS_EXT_RGBA;
+void error_exit(j_common_ptr cinfo)
+{
+  error_manager& error = *reinterpret_cast<error_manager*>(cinfo->err);
+  char message[JMSG_LENGTH_MAX];
+  (*cinfo->err->format_message)(cinfo, message);
+  error.message = message;
+  std::longjmp(error.jump, 1);
+}
 
-  width = cinfo.image_width;
-  height = cinfo.image_height;
-  std::size_t stride = 4u * width;
+jpeg_error_mgr* jumping_errors(error_manager& error)
+{
+  jpeg_std_error(&error.manager);
+  error.manager.error_exit = &error_exit;
+  return &error.manager;
+}
 
-  data.resize(stride*height);
-  unsigned char* data_it = &data[0];
+// Decodes a whole JPEG in memory, read in place. Errors longjmp back to
+// read, which throws; the destructor releases libjpeg either way.
+struct jpeg_memory_reader
+{
+  jpeg_memory_reader(unsigned char const* bytes, std::size_t size)
+  {
+    cinfo.err = jumping_errors(error);
+    if(setjmp(error.jump))
+      throw std::runtime_error("Could not start JPEG decoder: " + error.message);
+    jpeg_create_decompress(&cinfo);
+    // Older libjpeg declare the buffer non-const, it is only read
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(bytes), size);
+  }
 
-  std::vector<unsigned char> row(stride);
-  JSAMPROW row_pointer[1] = { &row[0] };
+  ~jpeg_memory_reader()
+  {
+    jpeg_destroy_decompress(&cinfo);
+  }
 
-  // Reading scan lines
-  jpeg_start_decompress(&cinfo);
-  while(cinfo.output_scanline < height)
+  void read(std::vector<unsigned char>& data, std::size_t& width, std::size_t& height
+            , std::size_t min_width, std::size_t min_height)
   {
-    jpeg_read_scanlines(&cinfo, row_pointer, 1);
-    std::memcpy(data_it, row_pointer[0], stride);
-    data_it += stride;
+    if(setjmp(error.jump))
+      throw std::runtime_error("Could not decode JPEG: " + error.message);
+
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_EXT_RGBA;
+    choose_scale(cinfo, min_width, min_height);
+    jpeg_calc_output_dimensions(&cinfo);
+
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+    std::size_t const stride = 4u * width;
+    data.resize(stride * height);
+
+    // Scan lines are decoded straight into their rows of the image
+    rows.resize(height);
+    for(std::size_t i = 0; i != height; ++i)
+      rows[i] = &data[0] + i*stride;
+
+    jpeg_start_decompress(&cinfo);
+    while(cinfo.output_scanline < height)
+    {
+      jpeg_read_scanlines(&cinfo, &rows[cinfo.output_scanline]
+                          , JDIMENSION(height - cinfo.output_scanline));
+    }
+    jpeg_finish_decompress(&cinfo);
   }
 
-  jpeg_finish_decompress(&cinfo);
-  jpeg_destroy_decompress(&cinfo);
-}
+private:
+  jpeg_decompress_struct cinfo;
+  error_manager error;
+  std::vector<JSAMPROW> rows;
+
+  jpeg_memory_reader(jpeg_memory_reader const&);
+  jpeg_memory_reader& operator=(jpeg_memory_reader const&);
+};
 
-texture load_jpg(binary_file const& file)
+// Decodes with libjpeg while the bytes arrive. Its source manager
+// suspends the decoder when the bytes so far are used up; the ones not
+// read yet are kept for the next call, from where libjpeg resumes.
+// Errors longjmp back to the entry point, which throws from there.
+struct jpeg_suspending_reader : content_sink
 {
-  std::cout << "load_jpg " << file.source_uri() << std::endl;
+  jpeg_suspending_reader(std::vector<unsigned char>& data
+                         , std::size_t min_width, std::size_t min_height)
+    : data(data), min_width(min_width), min_height(min_height)
+    , state(reading_header), skip(0), end_of_content(false)
+  {
+    cinfo.err = jumping_errors(error);
+    if(setjmp(error.jump))
+      throw std::runtime_error("Could not start JPEG decoder: " + error.message);
+    jpeg_create_decompress(&cinfo);
+    cinfo.client_data = this;
 
-  std::vector<unsigned char> data;
-  std::size_t width = 0;
-  std::size_t height = 0;
+    source.next_input_byte = 0;
+    source.bytes_in_buffer = 0;
+    source.init_source = &init_source;
+    source.fill_input_buffer = &fill_input_buffer;
+    source.skip_input_data = &skip_input_data;
+    source.resync_to_restart = &jpeg_resync_to_restart;
+    source.term_source = &term_source;
+    cinfo.src = &source;
+  }
 
-  load_jpg_to_rgba(file, data, width, height);
+  ~jpeg_suspending_reader()
+  {
+    jpeg_destroy_decompress(&cinfo);
+  }
 
-  opengl::texture texture;
+  void consume(unsigned char const* bytes, std::size_t size)
+  {
+    if(state == complete)
+      return;
+    std::size_t const skipped = std::min(skip, size);
+    skip -= skipped;
+    pending.erase(pending.begin(), pending.end() - source.bytes_in_buffer);
+    pending.insert(pending.end(), bytes + skipped, bytes + size);
+    source.next_input_byte = pending.empty() ? 0 : &pending[0];
+    source.bytes_in_buffer = pending.size();
+    resume();
+  }
 
-  glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
-  texture.bind();
+  /// @throw std::runtime_error if the image could not be decoded
+  void finish(std::size_t& width, std::size_t& height)
+  {
+    // A truncated image ends as with the memory source
+    end_of_content = true;
+    resume();
+    if(state != complete)
+      throw std::runtime_error("JPEG file is truncated");
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+  }
 
-  std::cout << "width " << width << " height " << height << std::endl;
+private:
+  enum decode_state { reading_header, starting, reading_scanlines, finishing, complete };
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA
-                , GL_UNSIGNED_BYTE, &data[0]);
+  // Continues from where the decoder suspended
+  void resume()
+  {
+    if(setjmp(error.jump))
+      throw std::runtime_error("Could not decode JPEG: " + error.message);
 
-  assert(glGetError() == GL_NO_ERROR);
+    if(state == reading_header)
+    {
+      if(jpeg_read_header(&cinfo, TRUE) == JPEG_SUSPENDED)
+        return;
+      cinfo.out_color_space = JCS_EXT_RGBA;
+      choose_scale(cinfo, min_width, min_height);
+      jpeg_calc_output_dimensions(&cinfo);
+      start_image();
+      state = starting;
+    }
+    if(state == starting)
+    {
+      if(!jpeg_start_decompress(&cinfo))
+        return;
+      state = reading_scanlines;
+    }
+    if(state == reading_scanlines)
+    {
+      while(cinfo.output_scanline < cinfo.output_height)
+      {
+        if(!jpeg_read_scanlines(&cinfo, &rows[cinfo.output_scanline]
+                                , cinfo.output_height - cinfo.output_scanline))
+          return;
+      }
+      state = finishing;
+    }
+    if(state == finishing)
+    {
+      if(!jpeg_finish_decompress(&cinfo))
+        return;
+      state = complete;
+    }
+  }
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  assert(glGetError() == GL_NO_ERROR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  assert(glGetError() == GL_NO_ERROR);
+  // Scan lines are decoded straight into their rows of the image
+  void start_image()
+  {
+    std::size_t const stride = 4u * cinfo.output_width;
+    data.resize(stride * cinfo.output_height);
+    rows.resize(cinfo.output_height);
+    for(std::size_t i = 0; i != rows.size(); ++i)
+      rows[i] = &data[0] + i*stride;
+  }
 
-  return texture;
+  static jpeg_suspending_reader& self(j_decompress_ptr cinfo)
+  {
+    return *static_cast<jpeg_suspending_reader*>(cinfo->client_data);
+  }
+
+  static void init_source(j_decompress_ptr)
+  {
+  }
+
+  static boolean fill_input_buffer(j_decompress_ptr cinfo)
+  {
+    if(!self(cinfo).end_of_content)
+      return FALSE;
+    static JOCTET const end_of_image[] = {0xFF, JPEG_EOI};
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    cinfo->src->next_input_byte = end_of_image;
+    cinfo->src->bytes_in_buffer = 2;
+    return TRUE;
+  }
+
+  static void skip_input_data(j_decompress_ptr cinfo, long count)
+  {
+    if(count <= 0)
+      return;
+    jpeg_source_mgr& source = *cinfo->src;
+    std::size_t const skipped = std::min(std::size_t(count), source.bytes_in_buffer);
+    source.next_input_byte += skipped;
+    source.bytes_in_buffer -= skipped;
+    // The rest is skipped as it arrives
+    self(cinfo).skip += std::size_t(count) - skipped;
+  }
+
+  static void term_source(j_decompress_ptr)
+  {
+  }
+
+  std::vector<unsigned char>& data;
+  std::size_t min_width, min_height;
+  decode_state state;
+  jpeg_decompress_struct cinfo;
+  error_manager error;
+  jpeg_source_mgr source;
+  std::vector<unsigned char> pending;
+  std::vector<JSAMPROW> rows;
+  std::size_t skip;
+  bool end_of_content;
+
+  jpeg_suspending_reader(jpeg_suspending_reader const&);
+  jpeg_suspending_reader& operator=(jpeg_suspending_reader const&);
+};
+
+}
+
+void jpg_scaled_size(std::size_t& width, std::size_t& height
+                     , std::size_t min_width, std::size_t min_height)
+{
+  unsigned int const num = scale_numerator(width, height, min_width, min_height);
+  width = (width * num + 7) / 8;
+  height = (height * num + 7) / 8;
+}
+
+void load_jpg_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height
+                      , std::size_t min_width, std::size_t min_height)
+{
+  if(!file.is_local() && file.file_content().empty())
+  {
+    // Decoded while it is downloaded
+    jpeg_suspending_reader reader(data, min_width, min_height);
+    file.stream_content(reader);
+    reader.finish(width, height);
+    return;
+  }
+
+  file_bytes bytes(file);
+  load_jpg_to_rgba(bytes.data(), bytes.size(), data, width, height, min_width, min_height);
+}
+
+void load_jpg_to_rgba(unsigned char const* bytes, std::size_t size, std::vector<unsigned char>& data
+                      , std::size_t& width, std::size_t& height
+                      , std::size_t min_width, std::size_t min_height)
+{
+  jpeg_memory_reader reader(bytes, size);
+  reader.read(data, width, height, min_width, min_height);
 }
 
 } } }
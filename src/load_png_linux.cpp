@@ -14,14 +14,6 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifdef GHTV_USE_GLUT
-#include <GL/glut.h>
-#endif
-#ifdef GHTV_USE_OPENGLES2
-#include <GLES2/gl2.h>
-#include <GLES2/gl2ext.h>
-#endif
-
 #include <ghtv/opengl/linux/load_png.hpp>
 
 #include <png.h>
@@ -30,19 +22,24 @@
 #include <cstring>
 #include <vector>
 #include <stdexcept>
+#include <string>
+#include <new>
 
 namespace ghtv { namespace opengl { namespace linux_ {
 
 namespace {
 
+// Reads straight from the borrowed file content
 struct png_stream
 {
-  png_stream(png_bytep file_content)
-    : m_mem_stream(file_content)
+  png_stream(unsigned char const* bytes, std::size_t size)
+    : m_mem_stream(bytes), m_mem_end(bytes + size)
   {  }
 
-  void read(png_bytep out_bytes, png_size_t size)
+  void read(png_structp png_ptr, png_bytep out_bytes, png_size_t size)
   {
+    if(size > std::size_t(m_mem_end - m_mem_stream))
+      png_error(png_ptr, "PNG file is truncated");
     std::memcpy(out_bytes, m_mem_stream, size);
     m_mem_stream += size;
   }
@@ -50,141 +47,239 @@ struct png_stream
   static
   void read_data_from_stream(png_structp png_ptr, png_bytep out_bytes, png_size_t size)
   {
-    png_stream* stream = (png_stream*) png_ptr->io_ptr;
-    stream->read(out_bytes, size);
+    png_stream* stream = (png_stream*) png_get_io_ptr(png_ptr);
+    stream->read(png_ptr, out_bytes, size);
   }
 
-  png_bytep m_mem_stream;
+  unsigned char const* m_mem_stream;
+  unsigned char const* m_mem_end;
 };
 
-} // end of anonymous namespace
-
-void load_png_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width_, std::size_t& height_)
+// Sets the transforms that expand the supported color types to 8 bit RGBA
+// @return false for color types not supported
+bool expand_to_rgba(png_structp png_ptr, png_infop info_ptr)
 {
-  std::cout << "load_png " << file.source_uri() << std::endl;
-
-  binary_file tmp_file = file;
-  tmp_file.load_content();
-  png_stream stream((png_bytep)&tmp_file.file_content()[0]);
-
-  png_structp png_ptr = png_create_read_struct
-    (PNG_LIBPNG_VER_STRING, 0, 0, 0);
-  if(!png_ptr) {
-    throw std::runtime_error("error: could not start libpng decoder");
-  }
-
-  png_infop info_ptr = png_create_info_struct(png_ptr);
-  if(!info_ptr)
-  {
-    png_destroy_read_struct(&png_ptr
-                            , static_cast<png_infopp>(0)
-                            , static_cast<png_infopp>(0));
-    throw std::runtime_error("error: could not start libpng decoder");
-  }
-
-  png_set_read_fn(png_ptr, &stream, png_stream::read_data_from_stream);
-
-  png_read_info(png_ptr, info_ptr);
-
-  png_uint_32 width = 0;
-  png_uint_32 height = 0;
-  int bit_depth = 0;
-  int color_type = -1;
-  int channels = png_get_channels(png_ptr, info_ptr);
-  png_uint_32 retval = png_get_IHDR(png_ptr, info_ptr
-                                    , &width, &height, &bit_depth, &color_type
-                                    , 0, 0, 0);
-  if(!retval) {
-    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-    throw std::runtime_error("Could not read PNG file IHDR.");
-  }
-
-//     std::cout << "channels: " << channels << std::endl;
-//     std::cout << "bit depth: " << bit_depth << std::endl;
-//     std::cout << "color_type: " << color_type << std::endl;
-
-  switch(color_type)
+  switch(png_get_color_type(png_ptr, info_ptr))
   {
   case PNG_COLOR_TYPE_PALETTE:
-    std::cout << "PNG_COLOR_TYPE_PALETTE" << std::endl;
     png_set_palette_to_rgb(png_ptr);
     if(png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS))
       png_set_tRNS_to_alpha(png_ptr);
     else
       png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
-    channels = 4;
     break;
   case PNG_COLOR_TYPE_GRAY_ALPHA:
     png_set_gray_to_rgb(png_ptr);
-    channels = 4;
     break;
   case PNG_COLOR_TYPE_GRAY:
     png_set_expand_gray_1_2_4_to_8(png_ptr);
     png_set_gray_to_rgb(png_ptr);
     png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
-    bit_depth = 8;
-    channels = 4;
     break;
   case PNG_COLOR_TYPE_RGB:
     png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
-    channels = 4;
     break;
   case PNG_COLOR_TYPE_RGBA:
     break;
   default:
-    // std::cerr << "Color type not implemented yet. " << color_type << std::endl;
-    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-    throw std::runtime_error("PNG color type not implemented yet");
+    return false;
   }
 
-  if(bit_depth == 16) {
+  if(png_get_bit_depth(png_ptr, info_ptr) == 16)
     png_set_strip_16(png_ptr);
-    bit_depth = 8;
+  return true;
+}
+
+// Keeps the message in the std::string passed as error pointer and
+// jumps back to the setjmp of the reader, which throws from there
+void store_error_and_jump(png_structp png_ptr, png_const_charp message)
+{
+  *static_cast<std::string*>(png_get_error_ptr(png_ptr)) = message;
+  longjmp(png_jmpbuf(png_ptr), 1);
+}
+
+// Decodes a whole PNG in memory. Errors longjmp back to read, which
+// throws; the destructor releases libpng either way.
+struct png_memory_reader
+{
+  png_memory_reader(unsigned char const* bytes, std::size_t size)
+    : stream(bytes, size), png_ptr(0), info_ptr(0)
+  {
+    png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &error, &store_error_and_jump, 0);
+    if(!png_ptr) {
+      throw std::runtime_error("error: could not start libpng decoder");
+    }
+    info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr)
+    {
+      png_destroy_read_struct(&png_ptr
+                              , static_cast<png_infopp>(0)
+                              , static_cast<png_infopp>(0));
+      throw std::runtime_error("error: could not start libpng decoder");
+    }
+    png_set_read_fn(png_ptr, &stream, png_stream::read_data_from_stream);
   }
 
-  std::vector<png_bytep> row_ptrs(height);
-  const std::size_t stride = width*channels*bit_depth/8;
-  data.resize(stride * height);
-  png_bytep data_ptr = &data[0];
-  for(std::size_t i = 0; i != height; ++i)
+  ~png_memory_reader()
   {
-    row_ptrs[i] = data_ptr + (i)*stride;
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
   }
 
-  png_read_image(png_ptr, &row_ptrs[0]);
-  width_ = width;
-  height_ = height;
-  png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-}
+  void read(std::vector<unsigned char>& data, std::size_t& width, std::size_t& height)
+  {
+    if(setjmp(png_jmpbuf(png_ptr)))
+      throw std::runtime_error("Could not decode PNG: " + error);
+
+    png_read_info(png_ptr, info_ptr);
+    if(!expand_to_rgba(png_ptr, info_ptr))
+      png_error(png_ptr, "PNG color type not implemented yet");
+
+    width = png_get_image_width(png_ptr, info_ptr);
+    height = png_get_image_height(png_ptr, info_ptr);
+    std::size_t const stride = 4u * width;
+    data.resize(stride * height);
+    rows.resize(height);
+    for(std::size_t i = 0; i != height; ++i)
+      rows[i] = &data[0] + i*stride;
+
+    png_read_image(png_ptr, &rows[0]);
+  }
+
+private:
+  png_stream stream;
+  std::vector<png_bytep> rows;
+  std::string error;
+  png_structp png_ptr;
+  png_infop info_ptr;
+
+  png_memory_reader(png_memory_reader const&);
+  png_memory_reader& operator=(png_memory_reader const&);
+};
 
-texture load_png(binary_file const& file)
+// Decodes with the libpng progressive reader while the bytes arrive.
+// libpng reports errors with longjmp, back to the entry point that fed
+// it, which throws from there.
+struct png_progressive_reader : content_sink
 {
-  std::vector<unsigned char> data;
-  std::size_t width = 0;
-  std::size_t height = 0;
+  png_progressive_reader(std::vector<unsigned char>& data)
+    : data(data), width(0), height(0), complete(false), png_ptr(0), info_ptr(0)
+  {
+    png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &error, &store_error_and_jump, 0);
+    if(!png_ptr) {
+      throw std::runtime_error("error: could not start libpng decoder");
+    }
+    info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr)
+    {
+      png_destroy_read_struct(&png_ptr
+                              , static_cast<png_infopp>(0)
+                              , static_cast<png_infopp>(0));
+      throw std::runtime_error("error: could not start libpng decoder");
+    }
+    png_set_progressive_read_fn(png_ptr, this, &info_callback, &row_callback, &end_callback);
+  }
+
+  ~png_progressive_reader()
+  {
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+  }
+
+  void consume(unsigned char const* bytes, std::size_t size)
+  {
+    if(complete)
+      return;
+    if(setjmp(png_jmpbuf(png_ptr)))
+      throw std::runtime_error("Could not decode PNG: " + error);
+    // Older libpng declare the buffer non-const, it is only read
+    png_process_data(png_ptr, info_ptr, const_cast<png_bytep>(bytes), size);
+  }
+
+  /// @throw std::runtime_error if the content ended before the image
+  void finish(std::size_t& width_, std::size_t& height_)
+  {
+    if(!complete)
+      throw std::runtime_error("PNG file is truncated");
+    width_ = width;
+    height_ = height;
+  }
+
+private:
+  static png_progressive_reader& self(png_structp png_ptr)
+  {
+    return *static_cast<png_progressive_reader*>(png_get_progressive_ptr(png_ptr));
+  }
 
-  load_png_to_rgba(file, data, width, height);
+  static void info_callback(png_structp png_ptr, png_infop info_ptr)
+  {
+    if(!expand_to_rgba(png_ptr, info_ptr))
+      png_error(png_ptr, "PNG color type not implemented yet");
+    png_set_interlace_handling(png_ptr);
+    png_read_update_info(png_ptr, info_ptr);
+
+    png_progressive_reader& reader = self(png_ptr);
+    reader.width = png_get_image_width(png_ptr, info_ptr);
+    reader.height = png_get_image_height(png_ptr, info_ptr);
+    // Passes of interlaced images are combined into the rows in place,
+    // the first one over zeros
+    bool allocated = true;
+    try
+    {
+      reader.data.assign(4u * reader.width * reader.height, 0);
+    }
+    catch(std::bad_alloc const&)
+    {
+      allocated = false;
+    }
+    if(!allocated)
+      png_error(png_ptr, "not enough memory for the image");
+  }
 
-  opengl::texture texture;
+  static void row_callback(png_structp png_ptr, png_bytep row, png_uint_32 row_number, int)
+  {
+    // Rows a pass leaves unchanged come without data
+    if(!row)
+      return;
+    png_progressive_reader& reader = self(png_ptr);
+    png_progressive_combine_row(png_ptr, &reader.data[4u * reader.width * row_number], row);
+  }
 
-  glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
-  texture.bind();
+  static void end_callback(png_structp png_ptr, png_infop)
+  {
+    self(png_ptr).complete = true;
+  }
 
-  std::cout << "width " << width << " height " << height << std::endl;
+  std::vector<unsigned char>& data;
+  std::size_t width, height;
+  bool complete;
+  std::string error;
+  png_structp png_ptr;
+  png_infop info_ptr;
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA
-                , GL_UNSIGNED_BYTE, &data[0]);
+  png_progressive_reader(png_progressive_reader const&);
+  png_progressive_reader& operator=(png_progressive_reader const&);
+};
 
-  assert(glGetError() == GL_NO_ERROR);
+} // end of anonymous namespace
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  assert(glGetError() == GL_NO_ERROR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  assert(glGetError() == GL_NO_ERROR);
+void load_png_to_rgba(binary_file const& file, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height)
+{
+  if(!file.is_local() && file.file_content().empty())
+  {
+    // Decoded while it is downloaded
+    png_progressive_reader reader(data);
+    file.stream_content(reader);
+    reader.finish(width, height);
+    return;
+  }
 
-  return texture;
+  file_bytes bytes(file);
+  load_png_to_rgba(bytes.data(), bytes.size(), data, width, height);
 }
 
+void load_png_to_rgba(unsigned char const* bytes, std::size_t size, std::vector<unsigned char>& data, std::size_t& width, std::size_t& height)
+{
+  png_memory_reader reader(bytes, size);
+  reader.read(data, width, height);
+}
 
 } } }
-
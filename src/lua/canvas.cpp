@@ -17,8 +17,9 @@
 #include <ghtv/opengl/linux/lua/canvas.hpp>
 
 #include <ghtv/opengl/linux/lua_player.hpp>
-#include <ghtv/opengl/linux/load_image.hpp>
+#include <ghtv/opengl/linux/image_cache.hpp>
 #include <ghtv/opengl/linux/idle_update.hpp>
+#include <ghtv/opengl/linux/display_list.hpp>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <boost/thread/lock_guard.hpp>
@@ -76,7 +77,12 @@ canvas canvas::canvas_image_new(std::string image_path)
 
   try
   {
-    load_image_to_rgba(player->get_canvas_file(image_path), *(c.rgba), c.width, c.height);
+    boost::shared_ptr<decoded_image const> image
+      = load_cached_image(player->get_canvas_file(image_path));
+    // The canvas can be drawn over, so it gets its own copy of the pixels
+    c.rgba->assign(image->pixels(), image->pixels() + 4u * image->width * image->height);
+    c.width = image->width;
+    c.height = image->height;
     c.mat = cv::Mat(c.height, c.width, CV_8UC4, &(*(c.rgba))[0]);
     c.stride = 4u * c.width;
     c.clip_w = c.crop_w = c.width;
@@ -456,6 +462,7 @@ void canvas::flush()
 {
   if(player && player->root_canvas_dirty)
   {
+    request_texture_refresh(player);
     // Is this call too much obscure?
     async_redraw();
   }
@@ -25,6 +25,7 @@
 #include <luabind/luabind.hpp>
 #include <luabind/tag_function.hpp>
 #include <luabind/make_function.hpp>
+#include <boost/optional.hpp>
 
 #include <iostream>
 
@@ -29,6 +29,8 @@
 #include <ghtv/opengl/linux/lua/timer.hpp>
 #include <ghtv/opengl/linux/lua/event.hpp>
 #include <ghtv/opengl/linux/lua/socket.hpp>
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/linux/texture_upload.hpp>
 
 #include <lua.hpp>
 #include <luabind/luabind.hpp>
@@ -204,19 +206,9 @@ void lua_player::get_textures(ghtv::opengl::texture*& textures, unsigned& size)
     // texture_.width = root_canvas->width;
     // texture_.height = root_canvas->height;
 
-    glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
-    texture_.bind();
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, root_canvas->width, root_canvas->height,
-                0, GL_RGBA, GL_UNSIGNED_BYTE, root_canvas->data());
-
-    assert(glGetError() == GL_NO_ERROR);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    assert(glGetError() == GL_NO_ERROR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    assert(glGetError() == GL_NO_ERROR);
+    uploader_.upload(texture_, root_canvas->data(), root_canvas->width, root_canvas->height);
   }
+  note_texture_update(texture_);
 }
 
 
@@ -288,9 +280,9 @@ void lua_player::delete_socket(int connection_id)
 void lua_player::load_lua_file(lua_State* thread, binary_file file)
 {
   file.load_content();
-  std::vector<char> const& c = file.file_content();
+  binary_file::content const& c = file.file_content();
   // TODO block if bytecode
-  int r = luaL_loadbuffer(thread, &c[0], c.size(), file.source_uri().c_str());
+  int r = luaL_loadbuffer(thread, c.data(), c.size(), file.source_uri().c_str());
   file.release_content();
   if (r !=  0)
   {
@@ -33,6 +33,20 @@
 #include <ghtv/opengl/linux/handle_events.hpp>
 #include <ghtv/opengl/linux/idle_update.hpp>
 #include <ghtv/opengl/linux/draw.hpp>
+#include <ghtv/opengl/linux/event_loop.hpp>
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/linux/display_list.hpp>
+#include <ghtv/opengl/linux/quad_batch.hpp>
+#include <ghtv/opengl/linux/texture_atlas.hpp>
+#include <ghtv/opengl/linux/frame_stats.hpp>
+#include <ghtv/opengl/linux/shader_variants.hpp>
+#include <ghtv/opengl/linux/image_cache.hpp>
+#include <ghtv/opengl/linux/disk_image_cache.hpp>
+#include <ghtv/opengl/linux/ncl_images.hpp>
+#include <ghtv/opengl/linux/texture_upload.hpp>
+#ifdef GHTV_USE_HEADLESS
+#include <ghtv/opengl/linux/headless.hpp>
+#endif
 #include <ghtv/opengl/main_state.hpp>
 #include <ghtv/opengl/linux/global_state.hpp>
 #include <ghtv/opengl/linux/static_texture_player.hpp>
@@ -97,6 +111,7 @@
 
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <linux/input.h>
 
 using ghtv::opengl::linux_::global_state;
@@ -207,7 +222,60 @@ void handle_key(std::string const& key, bool pressed = true)
   }
 }
       
+#ifndef GHTV_USE_GLUT
+bool handle_input_event(struct input_event const& ev)
+{
+  if (ev.value != 0 || ev.type != EV_KEY)
+    return false;
+
+  // std::cout << "read key " << ev.code << std::endl;
+  switch(ev.code)
+  {
+  case KEY_F1:
+    handle_key("RED");
+    break;
+  case KEY_F2:
+    handle_key("GREEN");
+    break;
+  case KEY_F3:
+    handle_key("YELLOW");
+    break;
+  case KEY_F4:
+    handle_key("BLUE");
+    break;
+  case KEY_LEFT:
+    handle_key("CURSOR_LEFT");
+    break;
+  case KEY_RIGHT:
+    handle_key("CURSOR_RIGHT");
+    break;
+  case KEY_UP:
+    handle_key("CURSOR_UP");
+    break;
+  case KEY_DOWN:
+    handle_key("CURSOR_DOWN");
+    break;
+  case KEY_ENTER:
+    handle_key("ENTER");
+    break;
+  case KEY_F9:
+    no_draw = !no_draw;
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+#endif
+
 #ifdef GHTV_USE_GLUT
+void display()
+{
+  // The window contents may have been lost
+  damage_screen();
+  draw();
+}
+
 void charKeyEvent(unsigned char k, bool pressed)
 {
   std::string key;
@@ -273,6 +341,7 @@ void specialKeyEvent(int k, bool pressed)
     key = "CURSOR_DOWN";
     break;
   case GLUT_KEY_F10:
+    print_frame_stats(std::cout);
     exit(0);
   default:
     return;
@@ -301,13 +370,33 @@ int main(int argc, char* argv[])
 
   boost::filesystem::path file_path;
   std::string input_path;
+  unsigned int image_cache_size = 64;
+  std::string image_disk_cache;
+  unsigned int image_disk_cache_size = 256;
+#ifndef GHTV_USE_GLUT
+  unsigned int frame_interval = 16;
+#endif
+#ifdef GHTV_USE_HEADLESS
+  unsigned int frames = 1;
+  std::string dump_dir;
+#endif
   {
     boost::program_options::options_description description("Allowed options");
     description.add_options()
       ("help", "Produce help message")
       ("ncl", boost::program_options::value<std::string>(), "NCL file")
-#ifdef GHTV_RASPBERRYPI
+      ("image-cache-size", boost::program_options::value<unsigned int>(&image_cache_size)->default_value(64), "Megabytes of decoded images kept for reuse")
+      ("image-disk-cache", boost::program_options::value<std::string>(&image_disk_cache), "Directory where decoded images are kept across runs, off if not given")
+      ("image-disk-cache-size", boost::program_options::value<unsigned int>(&image_disk_cache_size)->default_value(256), "Megabytes of decoded images kept on disk")
+#if !defined(GHTV_USE_GLUT) && !defined(GHTV_USE_HEADLESS)
       ("input", boost::program_options::value<std::string>(&input_path)->default_value("/dev/event1"), "Which /dev/input/* file to open for input")
+#endif
+#ifndef GHTV_USE_GLUT
+      ("frame-interval", boost::program_options::value<unsigned int>(&frame_interval)->default_value(16), "Minimum interval between two frames, in milliseconds")
+#endif
+#ifdef GHTV_USE_HEADLESS
+      ("frames", boost::program_options::value<unsigned int>(&frames)->default_value(1), "Number of frames to render before exiting")
+      ("dump-dir", boost::program_options::value<std::string>(&dump_dir), "Directory where every rendered frame is written as PNG")
 #endif
       ;
     boost::program_options::variables_map vm;
@@ -329,7 +418,12 @@ int main(int argc, char* argv[])
   }
 
   using ghtv::opengl::linux_::state;
+  ghtv::opengl::linux_::set_image_cache_budget(std::size_t(image_cache_size) << 20);
+  if(!image_disk_cache.empty())
+    ghtv::opengl::linux_::enable_disk_image_cache
+      (image_disk_cache, std::size_t(image_disk_cache_size) << 20);
 
+  std::vector<ghtv::opengl::linux_::image_source> image_sources;
   {
     boost::filesystem::path root_path = file_path.parent_path();
     std::cout << "root_path: " << root_path << std::endl;
@@ -348,7 +442,11 @@ int main(int argc, char* argv[])
         , "/", factory, imported_documents));
 
     ghtv::opengl::linux_::binary_file::initialize_binary_files();
-  }  
+
+    ghtv::opengl::linux_::collect_image_sources
+      (xmldoc, global_state.width, global_state.height, image_sources);
+  }
+  ghtv::opengl::linux_::install_frame_stats_signal_handler();  
 #ifdef GHTV_USE_GLUT
   glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_ALPHA | GLUT_DEPTH);
 
@@ -359,7 +457,10 @@ int main(int argc, char* argv[])
   int window = glutCreateWindow("GHTV Opengl Player");
   static_cast<void>(window);
 #endif
-#ifdef GHTV_BCM_HOST
+#if defined(GHTV_USE_HEADLESS)
+  if(!ghtv::opengl::linux_::create_headless_context())
+    return 1;
+#elif defined(GHTV_BCM_HOST)
   {
     bcm_host_init();
     std::atexit(bcm_host_deinit);
@@ -380,6 +481,7 @@ int main(int argc, char* argv[])
         EGL_GREEN_SIZE, 8,
         EGL_BLUE_SIZE, 8,
         EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 16,
         EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
         EGL_NONE
       };
@@ -460,7 +562,10 @@ int main(int argc, char* argv[])
     glClearColor(0.15f, 0.25f, 0.35f, 1.0f);
     glClear( GL_COLOR_BUFFER_BIT );
     assert(glGetError() == 0);
-
+  }
+#endif
+#ifdef GHTV_USE_OPENMAX
+  {
     global_state.reset_image_pipelines.reserve(1u);
     global_state.free_image_pipelines.resize(1u);
     for(std::vector<ghtv::opengl::linux_::state::image_pipeline>::iterator
@@ -472,87 +577,21 @@ int main(int argc, char* argv[])
   }
 #endif
 
+  // Decode the images the document may show while the rest is set up,
+  // so starting them does not wait for the decoders. Only now the context
+  // tells which KTX sidecars can be loaded instead.
+  ghtv::opengl::linux_::set_compressed_texture_formats
+    (ghtv::opengl::linux_::supported_compressed_formats());
+  ghtv::opengl::linux_::prefetch_images(file_path.parent_path().string(), image_sources);
+
   glEnable(GL_DEPTH_TEST);
   glDepthRange(0.f, 1.f);
   glDepthFunc(GL_LEQUAL);
   glEnable (GL_BLEND);
   glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-  GLchar vertex_shader_src[]
-    = "attribute vec2 vPosition;                            \n"
-      "attribute vec2 a_texCoord;                           \n"
-      "uniform float zindex;                                \n"
-      "uniform mat4 projection_matrix;                      \n"
-      "varying vec2 v_texCoord;                             \n"
-      "void main()                                          \n"
-      "{                                                    \n"
-      "    vec4 position = vec4(vPosition, zindex, 1.0);    \n"
-      "    gl_Position = projection_matrix*position;        \n"
-      "    v_texCoord = a_texCoord;                         \n"
-      "}                                                    \n"
-    ;
-
-  GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-
-  GLchar const* vertex_shader_src_tmp = vertex_shader_src;
-  glShaderSource(vertex_shader, 1, &vertex_shader_src_tmp, 0);
-  glCompileShader(vertex_shader);
-  GLint compiled = 0;
-  glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &compiled);
-  assert(!!compiled);
-
-  GLchar fragment_shader_src[]
-    = "uniform vec4 color;                            \n"
-      "uniform sampler2D s_texture;                   \n"
-      "varying vec2 v_texCoord;                       \n"
-      "uniform vec4 u_borderColor;                    \n"
-      "uniform vec4 u_clip;                           \n"
-      "void main()                                    \n"
-      "{                                              \n"
-      "    vec4 color;                                \n"
-      "    if(v_texCoord.x >= u_clip.x                \n"
-      "    && v_texCoord.y >= u_clip.y                \n"
-      "    && v_texCoord.x <= u_clip.z                \n"
-      "    && v_texCoord.y <= u_clip.w) {             \n"
-      "      color = texture2D(s_texture, v_texCoord);\n"
-      "    } else if(v_texCoord.x >= 0.0              \n"
-      "    && v_texCoord.y >= 0.0                     \n"
-      "    && v_texCoord.x <= 1.0                     \n"
-      "    && v_texCoord.y <= 1.0) {                  \n"
-      "      color = vec4(0.0, 0.0, 0.0, 0.0);        \n"
-      "    } else {                                   \n"
-      "      color = u_borderColor;                   \n"
-      "    }                                          \n"
-      "    gl_FragColor = color;                      \n"
-      "}                                              \n"
-    ;
-
-  GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-
-  GLchar const* fragment_shader_src_tmp = fragment_shader_src;
-  glShaderSource(fragment_shader, 1, &fragment_shader_src_tmp, 0);
-  glCompileShader(fragment_shader);
-  compiled = 0;
-  glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &compiled);
-  assert(!!compiled);
-
-  global_state.program_object = glCreateProgram();
-  assert(!!global_state.program_object);
-
-  glAttachShader(global_state.program_object, vertex_shader);
-  glAttachShader(global_state.program_object, fragment_shader);
-
-  glBindAttribLocation(global_state.program_object, 0, "vPosition");
-  glBindAttribLocation(global_state.program_object, 1, "a_texCoord");
-
-  glLinkProgram(global_state.program_object);
-
-  GLint linked;
-  glGetProgramiv(global_state.program_object, GL_LINK_STATUS, &linked);
-  assert(!!linked);
-
 #ifdef GHTV_USE_GLUT
-  glutDisplayFunc(&ghtv::opengl::linux_::draw);
+  glutDisplayFunc(&ghtv::opengl::linux_::display);
 
   glutKeyboardFunc(&ghtv::opengl::linux_::keyPressed);
   glutKeyboardUpFunc(&ghtv::opengl::linux_::keyReleased);
@@ -563,27 +602,6 @@ int main(int argc, char* argv[])
   glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  global_state.projection_location = glGetUniformLocation(global_state.program_object
-                                                          , "projection_matrix");
-  assert(global_state.projection_location != -1);
-
-  global_state.z_location = glGetUniformLocation(global_state.program_object, "zindex");
-  assert(global_state.z_location != -1);
-
-  global_state.texture_location = glGetUniformLocation(global_state.program_object, "s_texture");
-  assert(global_state.texture_location != -1);
-
-  global_state.border_color_location = glGetUniformLocation(global_state.program_object, "u_borderColor");
-  assert(global_state.border_color_location != -1);
-  
-  global_state.clip_location = glGetUniformLocation(global_state.program_object, "u_clip");
-  assert(global_state.clip_location != -1);
-
-  glUseProgram(global_state.program_object);
-
-  assert(glGetAttribLocation(global_state.program_object, "vPosition") == 0);
-  assert(glGetAttribLocation(global_state.program_object, "a_texCoord") == 1);
-
   float right = global_state.width
     , bottom = global_state.height
     ;
@@ -593,7 +611,7 @@ int main(int argc, char* argv[])
      , 0.0f      , -2.0f/bottom, 0.0f, 0.0f
      , 0.0f      , 0.0f        , -1.0f, 0.0f
      , -1.0f     , 1.0f        , 0.0f, 1.0f };
-  glUniformMatrix4fv(global_state.projection_location, 1, false, projection_matrix);
+  ghtv::opengl::linux_::load_shader_variants(projection_matrix);
 
   glViewport(0, 0, global_state.width, global_state.height);
 
@@ -606,9 +624,17 @@ int main(int argc, char* argv[])
      , descriptor
      , gntl::ref(*global_state.main_state.document)
      , screen_dimensions);
-
-#ifndef GHTV_USE_GLUT
-  int input = ::open(input_path.c_str(), O_RDONLY);
+  ghtv::opengl::linux_::invalidate_display_list();
+
+#if defined(GHTV_USE_HEADLESS)
+  int exit_status = ghtv::opengl::linux_::run_headless_loop(frames, frame_interval, dump_dir);
+  ghtv::opengl::linux_::print_atlas_statistics(std::cout);
+  ghtv::opengl::linux_::print_image_cache_statistics(std::cout);
+  ghtv::opengl::linux_::print_frame_stats(std::cout);
+  if(exit_status != 0)
+    return exit_status;
+#elif !defined(GHTV_USE_GLUT)
+  int input = ::open(input_path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
   if(input < 0)
   {
     std::cerr << "Couldn't open input " << input_path << std::endl;
@@ -618,74 +644,23 @@ int main(int argc, char* argv[])
   char name[256] = "Unknown";
 
   ioctl (input, EVIOCGNAME (sizeof (name)), name);
-  
-  bool quit = false;
-  while (!quit)
-  {
-    ghtv::opengl::linux_::handle_events();
-#endif
-    ghtv::opengl::linux_::draw();
-
-#ifndef GHTV_USE_GLUT
-    struct input_event ev;
-    
-    // std::cout << "Reading From : " << input_path << " (" << name << ")" << std::endl;
-    // std::cout << "reading key" << std::endl;
-    if (read (input, &ev, sizeof(ev)) < sizeof(ev))
-    {
-      std::cout << "Error reading input" << std::endl;
-      return -1;
-    }
-    using ghtv::opengl::linux_::handle_key;
-      
-    if (ev.value == 0 && ev.type == EV_KEY)
-    {
-      // std::cout << "read key " << ev.code << std::endl;
-
-      switch(ev.code)
-      {
-      case KEY_F1:
-        handle_key("RED");
-        break;
-      case KEY_F2:
-        handle_key("GREEN");
-        break;
-      case KEY_F3:
-        handle_key("YELLOW");
-        break;
-      case KEY_F4:
-        handle_key("BLUE");
-        break;
-      case KEY_LEFT:
-        handle_key("CURSOR_LEFT");
-        break;
-      case KEY_RIGHT:
-        handle_key("CURSOR_RIGHT");
-        break;
-      case KEY_UP:
-        handle_key("CURSOR_UP");
-        break;
-      case KEY_DOWN:
-        handle_key("CURSOR_DOWN");
-        break;
-      case KEY_ENTER:
-        handle_key("ENTER");
-        break;
-      // case KEY_F10:
-      //   quit = true;
-      //   break;
-      case KEY_F9:
-        ghtv::opengl::linux_::no_draw = !ghtv::opengl::linux_::no_draw;
-        break;
-      }
-    }
-  }
+  std::cout << "Reading From : " << input_path << " (" << name << ")" << std::endl;
+
+  int exit_status = ghtv::opengl::linux_::run_event_loop
+    (input, &ghtv::opengl::linux_::handle_input_event, frame_interval);
+  ::close(input);
+  ghtv::opengl::linux_::print_atlas_statistics(std::cout);
+  ghtv::opengl::linux_::print_image_cache_statistics(std::cout);
+  ghtv::opengl::linux_::print_frame_stats(std::cout);
+  if(exit_status != 0)
+    return exit_status;
 #else
   glutIdleFunc(ghtv::opengl::linux_::glut_idle_update_function);
   glutMainLoop();
 #endif
   
   global_state.main_state.active_players.clear();
+  ghtv::opengl::linux_::stop_image_prefetch();
   global_state.main_state.document.reset();
   global_state.main_state.parser_document.reset();
   global_state.xml_document.reset();
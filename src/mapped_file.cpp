@@ -0,0 +1,70 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/mapped_file.hpp>
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+mapped_file::mapped_file(std::string const& path)
+  : address(0), length(0)
+{
+  int const fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+
+  struct stat status;
+  if(::fstat(fd, &status) != 0)
+  {
+    int const error = errno;
+    ::close(fd);
+    throw std::runtime_error("Could not stat " + path + ": " + std::strerror(error));
+  }
+
+  length = status.st_size;
+  if(length)
+  {
+    void* mapping = ::mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapping == MAP_FAILED)
+    {
+      int const error = errno;
+      ::close(fd);
+      throw std::runtime_error("Could not map " + path + ": " + std::strerror(error));
+    }
+    // Only hints, failing them changes nothing
+    ::madvise(mapping, length, MADV_SEQUENTIAL);
+    ::madvise(mapping, length, MADV_WILLNEED);
+    address = static_cast<unsigned char const*>(mapping);
+  }
+  // The mapping outlives the descriptor
+  ::close(fd);
+}
+
+mapped_file::~mapped_file()
+{
+  if(address)
+    ::munmap(const_cast<unsigned char*>(address), length);
+}
+
+} } }
@@ -0,0 +1,187 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/ncl_images.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <map>
+#include <set>
+#include <cstring>
+#include <cstdlib>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+bool is_element(xmlNodePtr node, char const* name)
+{
+  return node->type == XML_ELEMENT_NODE
+    && !std::strcmp(reinterpret_cast<char const*>(node->name), name);
+}
+
+std::string attribute(xmlNodePtr node, char const* name)
+{
+  std::string value;
+  if(xmlChar* property = xmlGetProp(node, reinterpret_cast<xmlChar const*>(name)))
+  {
+    value = reinterpret_cast<char const*>(property);
+    xmlFree(property);
+  }
+  return value;
+}
+
+bool is_image(std::string const& source)
+{
+  return boost::algorithm::iends_with(source, ".png")
+    || boost::algorithm::iends_with(source, ".jpeg")
+    || boost::algorithm::iends_with(source, ".jpg")
+    || boost::algorithm::iends_with(source, ".gif");
+}
+
+// Region lengths are pixels or percentages of the parent region
+std::size_t region_length(std::string const& value, std::size_t parent)
+{
+  char* end = 0;
+  double const length = std::strtod(value.c_str(), &end);
+  if(end == value.c_str() || length < 0)
+    return 0;
+  return std::size_t(*end == '%' ? length * parent / 100 : length);
+}
+
+void region_size(xmlNodePtr region, std::size_t screen_width, std::size_t screen_height
+                 , std::size_t& width, std::size_t& height)
+{
+  std::size_t parent_width = screen_width, parent_height = screen_height;
+  if(region->parent && is_element(region->parent, "region"))
+    region_size(region->parent, screen_width, screen_height, parent_width, parent_height);
+
+  width = parent_width;
+  std::string value = attribute(region, "width");
+  if(!value.empty())
+    width = region_length(value, parent_width);
+  else
+  {
+    std::size_t const margins = region_length(attribute(region, "left"), parent_width)
+      + region_length(attribute(region, "right"), parent_width);
+    width = margins < parent_width ? parent_width - margins : 0;
+  }
+
+  value = attribute(region, "height");
+  if(!value.empty())
+    height = region_length(value, parent_height);
+  else
+  {
+    std::size_t const margins = region_length(attribute(region, "top"), parent_height)
+      + region_length(attribute(region, "bottom"), parent_height);
+    height = margins < parent_height ? parent_height - margins : 0;
+  }
+}
+
+void index_components(xmlNodePtr node, std::map<std::string, xmlNodePtr>& components)
+{
+  for(xmlNodePtr child = node->children; child; child = child->next)
+  {
+    if(child->type != XML_ELEMENT_NODE)
+      continue;
+    std::string id = attribute(child, "id");
+    if(!id.empty())
+      components.insert(std::make_pair(id, child));
+    index_components(child, components);
+  }
+}
+
+}
+
+void collect_image_sources(xmlDocPtr document, std::size_t screen_width, std::size_t screen_height
+                           , std::vector<image_source>& sources)
+{
+  xmlNodePtr root = xmlDocGetRootElement(document);
+  if(!root)
+    return;
+
+  std::map<std::string, xmlNodePtr> components;
+  index_components(root, components);
+
+  std::vector<xmlNodePtr> pending;
+  for(xmlNodePtr child = root->children; child; child = child->next)
+    if(is_element(child, "body"))
+      pending.push_back(child);
+
+  std::set<xmlNodePtr> visited;
+  // A media reused in regions of different sizes is decoded for each
+  std::set<std::pair<std::string, std::pair<std::size_t, std::size_t> > > collected;
+  while(!pending.empty())
+  {
+    xmlNodePtr node = pending.back();
+    pending.pop_back();
+    if(!visited.insert(node).second)
+      continue;
+
+    std::vector<std::string> reachable;
+    if(is_element(node, "media"))
+    {
+      image_source image = {attribute(node, "src"), 0, 0};
+      std::map<std::string, xmlNodePtr>::const_iterator
+        descriptor = components.find(attribute(node, "descriptor"));
+      if(descriptor != components.end())
+      {
+        std::map<std::string, xmlNodePtr>::const_iterator
+          region = components.find(attribute(descriptor->second, "region"));
+        if(region != components.end())
+          region_size(region->second, screen_width, screen_height, image.width, image.height);
+      }
+      if(is_image(image.source)
+         && collected.insert(std::make_pair(image.source, std::make_pair(image.width, image.height))).second)
+        sources.push_back(image);
+      reachable.push_back(attribute(node, "refer"));
+    }
+    else if(is_element(node, "switch"))
+    {
+      for(xmlNodePtr child = node->children; child; child = child->next)
+        if(is_element(child, "media") || is_element(child, "context")
+           || is_element(child, "switch"))
+          pending.push_back(child);
+    }
+    else
+    {
+      // body or context: what its ports start, and what its links may
+      // start or set
+      for(xmlNodePtr child = node->children; child; child = child->next)
+      {
+        if(is_element(child, "port"))
+          reachable.push_back(attribute(child, "component"));
+        else if(is_element(child, "link"))
+        {
+          for(xmlNodePtr bind = child->children; bind; bind = bind->next)
+            if(is_element(bind, "bind"))
+              reachable.push_back(attribute(bind, "component"));
+        }
+      }
+    }
+
+    for(std::vector<std::string>::const_iterator first = reachable.begin()
+          , last = reachable.end(); first != last; ++first)
+    {
+      std::map<std::string, xmlNodePtr>::const_iterator
+        component = components.find(*first);
+      if(component != components.end())
+        pending.push_back(component->second);
+    }
+  }
+}
+
+} } }
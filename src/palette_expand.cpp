@@ -0,0 +1,148 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ghtv/opengl/linux/palette_expand.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include <cstring>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+// Unaligned 32-bit load and store, which compilers turn into a single
+// instruction
+inline void store_pixel(unsigned char* rgba, boost::uint32_t color)
+{
+  std::memcpy(rgba, &color, 4);
+}
+
+inline bool transparent(boost::uint32_t color)
+{
+  unsigned char bytes[4];
+  std::memcpy(bytes, &color, 4);
+  return bytes[3] == 0;
+}
+
+}
+
+void make_palette_lut(unsigned char const* rgb, std::size_t count, int transparent
+                      , boost::uint32_t* lut)
+{
+  unsigned char const clear[4] = {0, 0, 0, 0};
+  for(std::size_t i = 0; i != palette_size; ++i)
+  {
+    if(i >= count || int(i) == transparent)
+    {
+      std::memcpy(&lut[i], clear, 4);
+      continue;
+    }
+    unsigned char const color[4] = {rgb[3*i], rgb[3*i + 1], rgb[3*i + 2], 0xff};
+    std::memcpy(&lut[i], color, 4);
+  }
+}
+
+// There is no gather before AVX2 nor on NEON: four table lookups go into
+// one vector register, which is stored, or blended with the pixels under
+// it, at once.
+void expand_palette(unsigned char const* indices, std::size_t count
+                    , boost::uint32_t const* lut, unsigned char* rgba)
+{
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i const colors = _mm_set_epi32(lut[indices[i + 3]], lut[indices[i + 2]]
+                                         , lut[indices[i + 1]], lut[indices[i]]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4*i), colors);
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for(; i + 4 <= count; i += 4)
+  {
+    uint32x4_t colors = vdupq_n_u32(lut[indices[i]]);
+    colors = vsetq_lane_u32(lut[indices[i + 1]], colors, 1);
+    colors = vsetq_lane_u32(lut[indices[i + 2]], colors, 2);
+    colors = vsetq_lane_u32(lut[indices[i + 3]], colors, 3);
+    vst1q_u8(rgba + 4*i, vreinterpretq_u8_u32(colors));
+  }
+#endif
+  for(; i != count; ++i)
+    store_pixel(rgba + 4*i, lut[indices[i]]);
+}
+
+void expand_palette_over(unsigned char const* indices, std::size_t count
+                         , boost::uint32_t const* lut, unsigned char* rgba)
+{
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  // x86 is little endian, alpha is the high byte
+  __m128i const alpha = _mm_set1_epi32(int(0xff000000u));
+  __m128i const zero = _mm_setzero_si128();
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i const colors = _mm_set_epi32(lut[indices[i + 3]], lut[indices[i + 2]]
+                                         , lut[indices[i + 1]], lut[indices[i]]);
+    // All ones where the color is transparent
+    __m128i const keep = _mm_cmpeq_epi32(_mm_and_si128(colors, alpha), zero);
+    __m128i* const target = reinterpret_cast<__m128i*>(rgba + 4*i);
+    __m128i const under = _mm_loadu_si128(target);
+    _mm_storeu_si128(target, _mm_or_si128(_mm_and_si128(keep, under)
+                                          , _mm_andnot_si128(keep, colors)));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  uint32x4_t const alpha = vdupq_n_u32(0xffu << 24);
+  for(; i + 4 <= count; i += 4)
+  {
+    uint32x4_t colors = vdupq_n_u32(lut[indices[i]]);
+    colors = vsetq_lane_u32(lut[indices[i + 1]], colors, 1);
+    colors = vsetq_lane_u32(lut[indices[i + 2]], colors, 2);
+    colors = vsetq_lane_u32(lut[indices[i + 3]], colors, 3);
+    // All ones where the color is opaque
+    uint32x4_t const draw = vtstq_u32(colors, alpha);
+    uint32x4_t const under = vreinterpretq_u32_u8(vld1q_u8(rgba + 4*i));
+    vst1q_u8(rgba + 4*i, vreinterpretq_u8_u32(vbslq_u32(draw, colors, under)));
+  }
+#endif
+  for(; i != count; ++i)
+  {
+    boost::uint32_t const color = lut[indices[i]];
+    if(!transparent(color))
+      store_pixel(rgba + 4*i, color);
+  }
+}
+
+void fill_rgba(unsigned char* rgba, std::size_t count, boost::uint32_t color)
+{
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  __m128i const colors = _mm_set1_epi32(color);
+  for(; i + 4 <= count; i += 4)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4*i), colors);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  uint8x16_t const colors = vreinterpretq_u8_u32(vdupq_n_u32(color));
+  for(; i + 4 <= count; i += 4)
+    vst1q_u8(rgba + 4*i, colors);
+#endif
+  for(; i != count; ++i)
+    store_pixel(rgba + 4*i, color);
+}
+
+} } }
@@ -0,0 +1,171 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#endif
+
+#include <ghtv/opengl/linux/quad_batch.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+// position(2) texture coordinate(2) depth(1) clip(4) border color(4) uv rect(4)
+std::size_t const floats_per_vertex = 17;
+std::size_t const vertex_stride = floats_per_vertex * sizeof(GLfloat);
+
+// Indices are GLushort, so at most 65536 vertices per draw call
+std::size_t const max_quads = 65536 / 4;
+
+}
+
+quad_batch::quad_batch()
+  : vertices(), runs(), quads(0)
+  , vertex_buffer(0), index_buffer(0), vertex_buffer_size(0)
+  , total_draw_calls(0)
+{
+}
+
+void quad_batch::create_buffers()
+{
+  glGenBuffers(1, &vertex_buffer);
+  glGenBuffers(1, &index_buffer);
+
+  // Every quad uses the same index pattern, so the index buffer never changes
+  std::vector<GLushort> indices(max_quads * 6);
+  for(std::size_t i = 0; i != max_quads; ++i)
+  {
+    GLushort const v = GLushort(i * 4);
+    GLushort const quad[] = {v, GLushort(v + 1), GLushort(v + 2)
+                             , GLushort(v + 1), GLushort(v + 2), GLushort(v + 3)};
+    std::copy(quad, quad + 6, indices.begin() + i * 6);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort)
+               , &indices[0], GL_STATIC_DRAW);
+}
+
+void quad_batch::add(draw_record const& record, GLfloat depth)
+{
+  if(quads == max_quads)
+    flush();
+
+  GLfloat const border_ratio[2]
+    = {record.border_size / (GLfloat)record.width, record.border_size / (GLfloat)record.height};
+  GLfloat const clip[4]
+    = {record.clip[0] / (GLfloat)record.width, record.clip[1] / (GLfloat)record.height
+       , record.clip[2] / (GLfloat)record.width, record.clip[3] / (GLfloat)record.height};
+
+  GLfloat const left   = (GLfloat)record.x;
+  GLfloat const top    = (GLfloat)record.y;
+  GLfloat const right  = left + record.width;
+  GLfloat const bottom = top + record.height;
+
+  GLfloat const corners[4][4]
+    = { {left , top   , 0.0f - border_ratio[0], 0.0f - border_ratio[1]}
+      , {right, top   , 1.0f + border_ratio[0], 0.0f - border_ratio[1]}
+      , {left , bottom, 0.0f - border_ratio[0], 1.0f + border_ratio[1]}
+      , {right, bottom, 1.0f + border_ratio[0], 1.0f + border_ratio[1]}};
+
+  for(std::size_t i = 0; i != 4; ++i)
+  {
+    vertices.insert(vertices.end(), corners[i], corners[i] + 4);
+    vertices.push_back(depth);
+    vertices.insert(vertices.end(), clip, clip + 4);
+    vertices.insert(vertices.end(), record.border_color, record.border_color + 3);
+    vertices.push_back(1.0f);
+    vertices.insert(vertices.end(), record.uv, record.uv + 4);
+  }
+
+  shader_variant const variant = select_shader_variant(record);
+  if(runs.empty() || runs.back().variant != variant
+     || runs.back().texture_id != record.texture_id)
+  {
+    run r = {variant, record.texture, record.texture_id, 0};
+    runs.push_back(r);
+  }
+  ++runs.back().quads;
+  ++quads;
+}
+
+void quad_batch::flush()
+{
+  if(!quads)
+    return;
+
+  if(!vertex_buffer)
+    create_buffers();
+
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+  std::size_t const size = vertices.size() * sizeof(GLfloat);
+  if(size > vertex_buffer_size)
+  {
+    vertex_buffer_size = size;
+    glBufferData(GL_ARRAY_BUFFER, size, &vertices[0], GL_STREAM_DRAW);
+  }
+  else
+  {
+    // Orphan the old storage so we do not wait for the previous frame
+    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size, 0, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, &vertices[0]);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+
+  GLubyte const* offset = 0;
+  glVertexAttribPointer(position_attribute, 2, GL_FLOAT, GL_FALSE, vertex_stride, offset);
+  glVertexAttribPointer(texture_coord_attribute, 2, GL_FLOAT, GL_FALSE, vertex_stride, offset + 2*sizeof(GLfloat));
+  glVertexAttribPointer(zindex_attribute, 1, GL_FLOAT, GL_FALSE, vertex_stride, offset + 4*sizeof(GLfloat));
+  glVertexAttribPointer(clip_attribute, 4, GL_FLOAT, GL_FALSE, vertex_stride, offset + 5*sizeof(GLfloat));
+  glVertexAttribPointer(border_color_attribute, 4, GL_FLOAT, GL_FALSE, vertex_stride, offset + 9*sizeof(GLfloat));
+  glVertexAttribPointer(uv_rect_attribute, 4, GL_FLOAT, GL_FALSE, vertex_stride, offset + 13*sizeof(GLfloat));
+  for(GLuint i = position_attribute; i <= uv_rect_attribute; ++i)
+    glEnableVertexAttribArray(i);
+
+  glActiveTexture(GL_TEXTURE0);
+  std::size_t first_quad = 0;
+  for(std::vector<run>::const_iterator first = runs.begin(), last = runs.end()
+        ; first != last; ++first)
+  {
+    use_shader_variant(first->variant);
+    if(first->variant != solid_variant)
+      first->texture->bind();
+    glDrawElements(GL_TRIANGLES, GLsizei(first->quads * 6), GL_UNSIGNED_SHORT
+                   , (GLushort const*)0 + first_quad * 6);
+    first_quad += first->quads;
+    ++total_draw_calls;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  assert(glGetError() == GL_NO_ERROR);
+
+  vertices.clear();
+  runs.clear();
+  quads = 0;
+}
+
+} } }
@@ -0,0 +1,320 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#endif
+
+#include <ghtv/opengl/linux/shader_manager.hpp>
+#include <ghtv/opengl/linux/gl_extensions.hpp>
+#include <ghtv/opengl/linux/clock.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+GLenum const program_binary_length = 0x8741;
+GLenum const num_program_binary_formats = 0x87FE;
+GLenum const program_binary_retrievable_hint = 0x8257;
+
+typedef void (*get_program_binary_function)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+typedef void (*program_binary_function)(GLuint, GLenum, void const*, GLint);
+typedef void (*program_parameteri_function)(GLuint, GLenum, GLint);
+
+char const cache_magic[8] = {'G', 'H', 'T', 'V', 'P', 'R', 'G', '1'};
+
+struct program_cache
+{
+  program_cache()
+    : initialized(false), get_program_binary(0), program_binary(0), program_parameteri(0)
+  {}
+
+  void initialize()
+  {
+    initialized = true;
+
+    std::string suffix;
+    if(gl_version_at_least(true, 3, 0) || has_gl_extension("GL_ARB_get_program_binary"))
+      suffix = "";
+    else if(has_gl_extension("GL_OES_get_program_binary"))
+      suffix = "OES";
+    else
+    {
+      std::cout << "shader cache: no program binaries" << std::endl;
+      return;
+    }
+
+    // Some drivers expose the extension without any binary format
+    GLint formats = 0;
+    glGetIntegerv(num_program_binary_formats, &formats);
+    if(formats > 0)
+    {
+      get_program_binary = (get_program_binary_function)
+        get_gl_proc_address("glGetProgramBinary" + suffix);
+      program_binary = (program_binary_function)
+        get_gl_proc_address("glProgramBinary" + suffix);
+      // Without the hint some desktop drivers give no binary, or one
+      // that does not load back. The OES extension has no hint.
+      if(suffix.empty())
+        program_parameteri = (program_parameteri_function)
+          get_gl_proc_address("glProgramParameteri");
+    }
+    if(!get_program_binary || !program_binary)
+    {
+      get_program_binary = 0;
+      program_binary = 0;
+      std::cout << "shader cache: no program binary formats" << std::endl;
+      return;
+    }
+
+    char const* cache_home = std::getenv("XDG_CACHE_HOME");
+    char const* home = std::getenv("HOME");
+    if(cache_home && *cache_home)
+      directory = boost::filesystem::path(cache_home) / "ghtv-opengl-player";
+    else if(home && *home)
+      directory = boost::filesystem::path(home) / ".cache" / "ghtv-opengl-player";
+  }
+
+  bool enabled() const { return program_binary && !directory.empty(); }
+
+  bool initialized;
+  get_program_binary_function get_program_binary;
+  program_binary_function program_binary;
+  /// Null where programs are retrievable without asking
+  program_parameteri_function program_parameteri;
+  boost::filesystem::path directory;
+};
+
+program_cache cache;
+
+// FNV-1a, good enough to tell apart sources and drivers
+void hash_bytes(boost::uint64_t& hash, char const* bytes, std::size_t size)
+{
+  for(std::size_t i = 0; i != size; ++i)
+  {
+    hash ^= static_cast<unsigned char>(bytes[i]);
+    hash *= 1099511628211ull;
+  }
+  // Separator, so that ("ab", "c") and ("a", "bc") differ
+  hash ^= 0xff;
+  hash *= 1099511628211ull;
+}
+
+void hash_string(boost::uint64_t& hash, char const* string)
+{
+  hash_bytes(hash, string ? string : "", string ? std::strlen(string) : 0);
+}
+
+std::string cache_key(char const* vertex_source, char const* fragment_source
+                      , shader_attribute const* attributes, std::size_t attribute_count)
+{
+  boost::uint64_t hash = 14695981039346656037ull;
+  hash_string(hash, reinterpret_cast<char const*>(glGetString(GL_VENDOR)));
+  hash_string(hash, reinterpret_cast<char const*>(glGetString(GL_RENDERER)));
+  hash_string(hash, reinterpret_cast<char const*>(glGetString(GL_VERSION)));
+  hash_string(hash, vertex_source);
+  hash_string(hash, fragment_source);
+  for(std::size_t i = 0; i != attribute_count; ++i)
+  {
+    hash_string(hash, boost::lexical_cast<std::string>(attributes[i].location).c_str());
+    hash_string(hash, attributes[i].name);
+  }
+
+  std::ostringstream key;
+  key << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return key.str();
+}
+
+// Returns 0 if there is no usable binary for @p key
+GLuint load_cached_program(std::string const& key)
+{
+  boost::filesystem::path const path = cache.directory / (key + ".bin");
+  std::ifstream file(path.string().c_str(), std::ios::binary);
+  if(!file)
+    return 0;
+
+  char magic[sizeof(cache_magic)];
+  boost::uint32_t format = 0, length = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&format), sizeof(format));
+  file.read(reinterpret_cast<char*>(&length), sizeof(length));
+  std::vector<char> binary(length);
+  if(length)
+    file.read(&binary[0], length);
+  if(!file || length == 0 || std::memcmp(magic, cache_magic, sizeof(magic)) != 0)
+  {
+    boost::system::error_code error;
+    boost::filesystem::remove(path, error);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  cache.program_binary(program, format, &binary[0], length);
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if(!linked)
+  {
+    // Usually a driver update that kept the version string
+    glDeleteProgram(program);
+    boost::system::error_code error;
+    boost::filesystem::remove(path, error);
+    return 0;
+  }
+  return program;
+}
+
+void store_program(std::string const& key, GLuint program)
+{
+  GLint length = 0;
+  glGetProgramiv(program, program_binary_length, &length);
+  if(length <= 0)
+    return;
+
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  GLsizei written = 0;
+  cache.get_program_binary(program, length, &written, &format, &binary[0]);
+  if(written <= 0)
+    return;
+
+  boost::system::error_code error;
+  boost::filesystem::create_directories(cache.directory, error);
+  if(error)
+  {
+    std::cout << "shader cache: could not create " << cache.directory << ": "
+              << error.message() << std::endl;
+    return;
+  }
+
+  // Written under a name of this process and renamed, so a concurrent
+  // start never reads a partial file nor writes into ours
+  boost::filesystem::path const path = cache.directory / (key + ".bin");
+  boost::filesystem::path const tmp_path
+    = cache.directory / (key + "." + boost::lexical_cast<std::string>(::getpid()) + ".tmp");
+  {
+    std::ofstream file(tmp_path.string().c_str(), std::ios::binary | std::ios::trunc);
+    boost::uint32_t const format32 = format, length32 = written;
+    file.write(cache_magic, sizeof(cache_magic));
+    file.write(reinterpret_cast<char const*>(&format32), sizeof(format32));
+    file.write(reinterpret_cast<char const*>(&length32), sizeof(length32));
+    file.write(&binary[0], written);
+    if(!file)
+    {
+      boost::filesystem::remove(tmp_path, error);
+      return;
+    }
+  }
+  boost::filesystem::rename(tmp_path, path, error);
+}
+
+GLuint compile_shader(GLenum type, char const* source)
+{
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, 0);
+  glCompileShader(shader);
+  GLint compiled = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if(!compiled)
+  {
+    GLchar log[1024] = "";
+    glGetShaderInfoLog(shader, sizeof(log), 0, log);
+    glDeleteShader(shader);
+    throw std::runtime_error(std::string("Could not compile shader: ") + log);
+  }
+  return shader;
+}
+
+GLuint compile_program(char const* vertex_source, char const* fragment_source
+                       , shader_attribute const* attributes, std::size_t attribute_count)
+{
+  GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+  GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  for(std::size_t i = 0; i != attribute_count; ++i)
+    glBindAttribLocation(program, attributes[i].location, attributes[i].name);
+  if(cache.enabled() && cache.program_parameteri)
+    cache.program_parameteri(program, program_binary_retrievable_hint, GL_TRUE);
+  glLinkProgram(program);
+
+  // The program keeps them alive as long as it needs them
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if(!linked)
+  {
+    GLchar log[1024] = "";
+    glGetProgramInfoLog(program, sizeof(log), 0, log);
+    glDeleteProgram(program);
+    throw std::runtime_error(std::string("Could not link program: ") + log);
+  }
+  return program;
+}
+
+}
+
+GLuint load_program(char const* vertex_source, char const* fragment_source
+                    , shader_attribute const* attributes, std::size_t attribute_count)
+{
+  if(!cache.initialized)
+    cache.initialize();
+
+  boost::int64_t const start = monotonic_microseconds();
+  std::string key;
+  if(cache.enabled())
+  {
+    key = cache_key(vertex_source, fragment_source, attributes, attribute_count);
+    if(GLuint program = load_cached_program(key))
+    {
+      std::cout << "shader cache: loaded program " << key << " in "
+                << (monotonic_microseconds() - start) / 1000.0 << "ms" << std::endl;
+      return program;
+    }
+  }
+
+  GLuint program = compile_program(vertex_source, fragment_source, attributes, attribute_count);
+  std::cout << "shader cache: compiled program " << key << " in "
+            << (monotonic_microseconds() - start) / 1000.0 << "ms" << std::endl;
+  if(cache.enabled())
+    store_program(key, program);
+  return program;
+}
+
+} } }
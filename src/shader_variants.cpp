@@ -0,0 +1,159 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#endif
+
+#include <ghtv/opengl/linux/shader_variants.hpp>
+#include <ghtv/opengl/linux/shader_manager.hpp>
+#include <ghtv/opengl/linux/quad_batch.hpp>
+
+#include <string>
+#include <cassert>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+char const vertex_shader_src[]
+  = "attribute vec2 vPosition;                            \n"
+    "attribute vec2 a_texCoord;                           \n"
+    "attribute float a_zindex;                            \n"
+    "attribute vec4 a_clip;                               \n"
+    "attribute vec4 a_borderColor;                        \n"
+    "attribute vec4 a_uvRect;                             \n"
+    "uniform mat4 projection_matrix;                      \n"
+    "varying vec2 v_texCoord;                             \n"
+    "varying vec2 v_atlasCoord;                           \n"
+    "varying vec4 v_clip;                                 \n"
+    "varying vec4 v_borderColor;                          \n"
+    "void main()                                          \n"
+    "{                                                    \n"
+    "    vec4 position = vec4(vPosition, a_zindex, 1.0);  \n"
+    "    gl_Position = projection_matrix*position;        \n"
+    "    v_texCoord = a_texCoord;                         \n"
+    "    v_atlasCoord = mix(a_uvRect.xy, a_uvRect.zw, a_texCoord);\n"
+    "    v_clip = a_clip;                                 \n"
+    "    v_borderColor = a_borderColor;                   \n"
+    "}                                                    \n"
+  ;
+
+// Tests are written with step() so even the clipped and bordered variants
+// do not branch
+char const fragment_shader_src[]
+  = "#ifdef GL_ES                                   \n"
+    "precision mediump float;                       \n"
+    "#endif                                         \n"
+    "uniform sampler2D s_texture;                   \n"
+    "varying vec2 v_texCoord;                       \n"
+    "varying vec2 v_atlasCoord;                     \n"
+    "varying vec4 v_clip;                           \n"
+    "varying vec4 v_borderColor;                    \n"
+    "void main()                                    \n"
+    "{                                              \n"
+    "#if defined(SOLID)                             \n"
+    "    gl_FragColor = v_borderColor;              \n"
+    "#elif defined(PLAIN)                           \n"
+    "    gl_FragColor = texture2D(s_texture, v_atlasCoord);\n"
+    "#else                                          \n"
+    "    vec2 in_clip = step(v_clip.xy, v_texCoord) \n"
+    "      * step(v_texCoord, v_clip.zw);           \n"
+    "    vec4 color = texture2D(s_texture, v_atlasCoord)\n"
+    "      * (in_clip.x * in_clip.y);               \n"
+    "#ifdef BORDERED                                \n"
+    "    vec2 in_texture = step(vec2(0.0), v_texCoord)\n"
+    "      * step(v_texCoord, vec2(1.0));           \n"
+    "    color = mix(v_borderColor, color, in_texture.x * in_texture.y);\n"
+    "#endif                                         \n"
+    "    gl_FragColor = color;                      \n"
+    "#endif                                         \n"
+    "}                                              \n"
+  ;
+
+char const* const variant_defines[shader_variant_count] =
+  {
+    "#define PLAIN\n"
+    , "#define CLIPPED\n"
+    , "#define CLIPPED\n#define BORDERED\n"
+    , "#define SOLID\n"
+  };
+
+struct variant_program
+{
+  GLuint program;
+  GLint projection_location;
+};
+
+variant_program programs[shader_variant_count];
+GLuint current_program = 0;
+
+}
+
+void load_shader_variants(GLfloat const* projection_matrix)
+{
+  shader_attribute const attributes[] =
+    {
+      {position_attribute, "vPosition"}
+      , {texture_coord_attribute, "a_texCoord"}
+      , {zindex_attribute, "a_zindex"}
+      , {clip_attribute, "a_clip"}
+      , {border_color_attribute, "a_borderColor"}
+      , {uv_rect_attribute, "a_uvRect"}
+    };
+
+  for(std::size_t i = 0; i != shader_variant_count; ++i)
+  {
+    std::string const fragment_source = variant_defines[i] + std::string(fragment_shader_src);
+    GLuint program = load_program(vertex_shader_src, fragment_source.c_str()
+                                  , attributes, sizeof(attributes)/sizeof(attributes[0]));
+    programs[i].program = program;
+    programs[i].projection_location = glGetUniformLocation(program, "projection_matrix");
+    assert(programs[i].projection_location != -1);
+
+    glUseProgram(program);
+    glUniformMatrix4fv(programs[i].projection_location, 1, GL_FALSE, projection_matrix);
+    // The solid variant has no sampler
+    GLint texture_location = glGetUniformLocation(program, "s_texture");
+    if(texture_location != -1)
+      glUniform1i(texture_location, 0);
+    current_program = program;
+  }
+}
+
+shader_variant select_shader_variant(draw_record const& record)
+{
+  if(!record.texture_id)
+    return solid_variant;
+  if(record.border_size > 0)
+    return bordered_variant;
+  return is_clipped(record) ? clipped_variant : plain_variant;
+}
+
+void use_shader_variant(shader_variant variant)
+{
+  if(programs[variant].program != current_program)
+  {
+    current_program = programs[variant].program;
+    glUseProgram(current_program);
+  }
+}
+
+} } }
@@ -25,6 +25,9 @@
 
 #include <ghtv/opengl/linux/text_player.hpp>
 #include <ghtv/opengl/linux/image_conversion.hpp>
+#include <ghtv/opengl/linux/compositor.hpp>
+#include <ghtv/opengl/linux/display_list.hpp>
+#include <ghtv/opengl/linux/texture_upload.hpp>
 #include <ghtv/opengl/texture.hpp>
 
 #include <pango/pangocairo.h>
@@ -212,26 +215,20 @@ struct text_player::text_player_impl
     // To texture
     {
       cairo_surface_flush(cairo_surface);
-      std::vector<unsigned char> rgba_data;
-      rgba_from_cairo_ARGB32(
+      std::vector<unsigned char> pixels;
+      bool const bgra = bgra_upload_supported();
+      (bgra ? unpremultiplied_bgra_from_cairo_ARGB32 : unpremultiplied_rgba_from_cairo_ARGB32)(
         cairo_image_surface_get_data(cairo_surface)
         , m_width
         , m_height
         , cairo_image_surface_get_stride(cairo_surface)
-        , rgba_data
+        , pixels
       );
 
-      glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
-      m_texture.bind();
+      upload_texture(m_texture, &pixels[0], m_width, m_height
+                     , bgra ? bgra_pixels : rgba_pixels);
 
-      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &(rgba_data[0]));
-
-      assert(glGetError() == GL_NO_ERROR);
-
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-      assert(glGetError() == GL_NO_ERROR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-      assert(glGetError() == GL_NO_ERROR);
+      note_texture_update(m_texture);
     }
 
     g_object_unref(layout);
@@ -262,6 +259,7 @@ void text_player::get_textures(opengl::texture*& textures, unsigned& size)
 void text_player::start()
 {
   impl->start();
+  request_texture_refresh(this);
 }
 
 bool text_player::set_property(std::string const& name, std::string const& value)
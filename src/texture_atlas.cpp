@@ -0,0 +1,225 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#endif
+
+#include <ghtv/opengl/linux/texture_atlas.hpp>
+#include <ghtv/opengl/linux/texture_upload.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cassert>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+int const page_size = 1024;
+// Keeps neighbour images from bleeding into each other when filtered.
+// The gutter repeats the edge texels of its image.
+int const padding = 1;
+
+struct shelf
+{
+  int y, height, next_x;
+};
+
+struct atlas_page
+{
+  atlas_page()
+    : texture(), shelves(), next_shelf_y(0), live_regions(0)
+    , used_area(0), released_area(0)
+  {}
+
+  opengl::texture texture;
+  std::vector<shelf> shelves;
+  int next_shelf_y;
+  std::size_t live_regions;
+  // Pixels of live images, and pixels of released images that shelf packing
+  // can not reuse until the whole page is empty
+  std::size_t used_area, released_area;
+
+  void reset()
+  {
+    shelves.clear();
+    next_shelf_y = 0;
+    used_area = released_area = 0;
+  }
+
+  // Returns false if there is no room left
+  bool allocate(int width, int height, int& x, int& y)
+  {
+    // Best fit: the shelf wasting the least height
+    shelf* best = 0;
+    for(std::vector<shelf>::iterator first = shelves.begin(), last = shelves.end()
+          ; first != last; ++first)
+    {
+      if(first->height >= height && page_size - first->next_x >= width
+         && (!best || first->height < best->height))
+        best = &*first;
+    }
+
+    // Open a new shelf unless an existing one fits snugly
+    if((!best || best->height > height + height / 2)
+       && page_size - next_shelf_y >= height)
+    {
+      shelf s = {next_shelf_y, height, 0};
+      shelves.push_back(s);
+      next_shelf_y += height;
+      best = &shelves.back();
+    }
+
+    if(!best)
+      return false;
+
+    x = best->next_x;
+    y = best->y;
+    best->next_x += width;
+    return true;
+  }
+};
+
+std::vector<atlas_page> pages;
+
+// Copies the @p width x @p height image into the middle of @p padded,
+// with its edge rows and columns repeated into the gutter around it
+void pad_image(unsigned char const* rgba, std::size_t width, std::size_t height
+               , std::vector<unsigned char>& padded)
+{
+  std::size_t const padded_width = width + 2*padding;
+  std::size_t const padded_height = height + 2*padding;
+  padded.resize(4 * padded_width * padded_height);
+  for(std::size_t row = 0; row != padded_height; ++row)
+  {
+    std::size_t const source_row
+      = row < std::size_t(padding) ? 0
+      : std::min(row - padding, height - 1);
+    unsigned char const* source = rgba + 4 * width * source_row;
+    unsigned char* target = &padded[4 * padded_width * row];
+    for(int i = 0; i != padding; ++i)
+      std::copy(source, source + 4, target + 4*i);
+    std::copy(source, source + 4*width, target + 4*padding);
+    for(int i = 0; i != padding; ++i)
+      std::copy(source + 4*(width - 1), source + 4*width, target + 4*(padding + width + i));
+  }
+}
+
+}
+
+bool atlas_insert(unsigned char const* rgba, std::size_t width, std::size_t height
+                  , opengl::texture& page_texture, atlas_region& region)
+{
+  if(width == 0 || height == 0
+     || width > atlas_max_image_size || height > atlas_max_image_size)
+    return false;
+
+  int const padded_width = int(width) + 2*padding;
+  int const padded_height = int(height) + 2*padding;
+
+  int x = 0, y = 0;
+  std::size_t page = 0;
+  for(; page != pages.size(); ++page)
+  {
+    if(pages[page].allocate(padded_width, padded_height, x, y))
+      break;
+  }
+  if(page == pages.size())
+  {
+    pages.push_back(atlas_page());
+    upload_texture(pages.back().texture, 0, page_size, page_size);
+    bool allocated = pages.back().allocate(padded_width, padded_height, x, y);
+    assert(allocated);
+    static_cast<void>(allocated);
+    std::cout << "texture atlas: created page " << page << std::endl;
+  }
+
+  atlas_page& p = pages[page];
+  ++p.live_regions;
+  p.used_area += width * height;
+
+  region.page = int(page);
+  region.x = x + padding;
+  region.y = y + padding;
+  region.width = int(width);
+  region.height = int(height);
+  region.uv[0] = region.x / GLfloat(page_size);
+  region.uv[1] = region.y / GLfloat(page_size);
+  region.uv[2] = (region.x + region.width) / GLfloat(page_size);
+  region.uv[3] = (region.y + region.height) / GLfloat(page_size);
+
+  std::vector<unsigned char> padded;
+  pad_image(rgba, width, height, padded);
+  update_texture(p.texture, x, y, padded_width, padded_height, &padded[0]);
+
+  page_texture = p.texture;
+  return true;
+}
+
+opengl::texture load_rgba_texture(unsigned char const* rgba, std::size_t width, std::size_t height
+                                  , atlas_region& region)
+{
+  opengl::texture texture;
+  if(atlas_insert(rgba, width, height, texture, region))
+    return texture;
+
+  region = atlas_region();
+  upload_texture(texture, rgba, width, height);
+  return texture;
+}
+
+void atlas_release(atlas_region const& region)
+{
+  if(!region.valid() || std::size_t(region.page) >= pages.size())
+    return;
+
+  atlas_page& p = pages[region.page];
+  assert(p.live_regions > 0);
+  std::size_t const area = std::size_t(region.width) * region.height;
+  p.used_area -= area;
+  p.released_area += area;
+  if(--p.live_regions == 0)
+    p.reset();
+}
+
+void print_atlas_statistics(std::ostream& os)
+{
+  std::size_t const page_area = std::size_t(page_size) * page_size;
+  for(std::size_t i = 0; i != pages.size(); ++i)
+  {
+    atlas_page const& p = pages[i];
+    std::size_t shelf_area = 0;
+    for(std::vector<shelf>::const_iterator first = p.shelves.begin(), last = p.shelves.end()
+          ; first != last; ++first)
+      shelf_area += std::size_t(first->next_x) * first->height;
+
+    // Fragmentation: area handed out by the shelves that does not hold a
+    // live image, either released or lost to padding and short images.
+    os << "texture atlas page " << i << ": " << p.live_regions << " images, occupancy "
+       << 100.0 * p.used_area / page_area << "%, fragmentation "
+       << (shelf_area ? 100.0 * (shelf_area - p.used_area) / shelf_area : 0.0) << "% ("
+       << 100.0 * p.released_area / page_area << "% released), free "
+       << 100.0 * (page_area - shelf_area) / page_area << "%" << std::endl;
+  }
+}
+
+} } }
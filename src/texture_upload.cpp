@@ -0,0 +1,258 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef GHTV_USE_GLUT
+#include <GL/glut.h>
+#endif
+#ifdef GHTV_USE_OPENGLES2
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#endif
+
+#include <ghtv/opengl/linux/texture_upload.hpp>
+#include <ghtv/opengl/linux/gl_extensions.hpp>
+#include <ghtv/opengl/linux/frame_stats.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cassert>
+
+namespace ghtv { namespace opengl { namespace linux_ {
+
+namespace {
+
+GLenum const pixel_unpack_buffer = 0x88EC;
+GLbitfield const map_write_bit = 0x0002;
+GLbitfield const map_invalidate_buffer_bit = 0x0008;
+// GL_BGRA on desktop OpenGL, GL_BGRA_EXT on OpenGL ES
+GLenum const bgra_format = 0x80E1;
+
+typedef void* (*map_buffer_range_function)(GLenum, GLintptr, GLsizeiptr, GLbitfield);
+typedef GLboolean (*unmap_buffer_function)(GLenum);
+
+// Enough for the driver to still be reading one buffer while the next
+// ones are filled
+std::size_t const pbo_count = 3;
+
+struct upload_state
+{
+  upload_state()
+    : initialized(false), has_pbo(false), has_bgra(false), has_etc1(false), has_etc2(false)
+    , next(0)
+    , map_buffer_range(0), unmap_buffer(0)
+  {
+    std::fill(pbos, pbos + pbo_count, 0u);
+    std::fill(pbo_sizes, pbo_sizes + pbo_count, 0u);
+  }
+
+  void initialize()
+  {
+    initialized = true;
+    has_pbo = gl_version_at_least(true, 3, 0) || gl_version_at_least(false, 2, 1)
+      || has_gl_extension("GL_ARB_pixel_buffer_object")
+      || has_gl_extension("GL_NV_pixel_buffer_object");
+    if(has_pbo)
+    {
+      glGenBuffers(pbo_count, pbos);
+      map_buffer_range = (map_buffer_range_function)get_gl_proc_address("glMapBufferRange");
+      unmap_buffer = (unmap_buffer_function)get_gl_proc_address("glUnmapBuffer");
+      if(!map_buffer_range || !unmap_buffer)
+        map_buffer_range = 0;
+    }
+
+    // if 0x01 is the first byte the machine is little endian
+    long multibyte_integer = 1;
+    bool const is_little_endian = ((char*)&multibyte_integer)[0] != 0;
+    has_bgra = is_little_endian
+      && (gl_version_at_least(false, 1, 2)
+          || has_gl_extension("GL_EXT_texture_format_BGRA8888"));
+
+    has_etc2 = gl_version_at_least(true, 3, 0) || has_gl_extension("GL_ARB_ES3_compatibility");
+    has_etc1 = has_gl_extension("GL_OES_compressed_ETC1_RGB8_texture");
+
+    std::cout << "texture upload: pixel buffer objects " << (has_pbo ? "yes" : "no")
+              << ", mapped " << (map_buffer_range ? "yes" : "no")
+              << ", BGRA " << (has_bgra ? "yes" : "no")
+              << ", ETC1 " << (has_etc1 || has_etc2 ? "yes" : "no")
+              << ", ETC2 " << (has_etc2 ? "yes" : "no") << std::endl;
+  }
+
+  // Copies @p size bytes into the next buffer of the ring and leaves it
+  // bound to GL_PIXEL_UNPACK_BUFFER
+  void stream(unsigned char const* data, std::size_t size)
+  {
+    std::size_t const i = next;
+    next = (next + 1) % pbo_count;
+
+    glBindBuffer(pixel_unpack_buffer, pbos[i]);
+    if(pbo_sizes[i] < size)
+    {
+      glBufferData(pixel_unpack_buffer, size, 0, GL_STREAM_DRAW);
+      pbo_sizes[i] = size;
+    }
+
+    void* mapped = map_buffer_range
+      ? map_buffer_range(pixel_unpack_buffer, 0, size, map_write_bit | map_invalidate_buffer_bit)
+      : 0;
+    if(mapped)
+    {
+      std::memcpy(mapped, data, size);
+      unmap_buffer(pixel_unpack_buffer);
+    }
+    else
+    {
+      // Orphans the storage the driver may still be reading from
+      glBufferData(pixel_unpack_buffer, pbo_sizes[i], 0, GL_STREAM_DRAW);
+      glBufferSubData(pixel_unpack_buffer, 0, size, data);
+    }
+  }
+
+  bool initialized, has_pbo, has_bgra, has_etc1, has_etc2;
+  GLuint pbos[pbo_count];
+  std::size_t pbo_sizes[pbo_count];
+  std::size_t next;
+
+  map_buffer_range_function map_buffer_range;
+  unmap_buffer_function unmap_buffer;
+};
+
+upload_state uploads;
+
+GLenum gl_format(pixel_format format)
+{
+  assert(format == rgba_pixels || uploads.has_bgra);
+  return format == bgra_pixels ? bgra_format : GL_RGBA;
+}
+
+// OpenGL ES wants the internal format to match the pixels, desktop
+// OpenGL has no BGRA internal format
+GLenum gl_internal_format(pixel_format format)
+{
+#ifdef GHTV_USE_OPENGLES2
+  return gl_format(format);
+#else
+  return GL_RGBA;
+#endif
+}
+
+}
+
+bool bgra_upload_supported()
+{
+  if(!uploads.initialized)
+    uploads.initialize();
+  return uploads.has_bgra;
+}
+
+void upload_texture(opengl::texture& texture, unsigned char const* rgba
+                    , std::size_t width, std::size_t height, pixel_format format)
+{
+  scoped_stat_timer timer(upload_time_stat);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  texture.bind();
+  glTexImage2D(GL_TEXTURE_2D, 0, gl_internal_format(format), width, height, 0, gl_format(format)
+               , GL_UNSIGNED_BYTE, rgba);
+  assert(glGetError() == GL_NO_ERROR);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  assert(glGetError() == GL_NO_ERROR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  assert(glGetError() == GL_NO_ERROR);
+}
+
+std::vector<boost::uint32_t> supported_compressed_formats()
+{
+  if(!uploads.initialized)
+    uploads.initialize();
+  std::vector<boost::uint32_t> formats;
+  if(uploads.has_etc1 || uploads.has_etc2)
+    formats.push_back(etc1_rgb8_format);
+  if(uploads.has_etc2)
+  {
+    formats.push_back(etc2_rgb8_format);
+    formats.push_back(etc2_rgba8_eac_format);
+  }
+  return formats;
+}
+
+void upload_compressed_texture(opengl::texture& texture, compressed_image const& image)
+{
+  scoped_stat_timer timer(upload_time_stat);
+  if(!uploads.initialized)
+    uploads.initialize();
+
+  // ETC1 blocks are valid ETC2 ones, for contexts without the extension
+  GLenum const format = image.format == etc1_rgb8_format && !uploads.has_etc1
+    ? etc2_rgb8_format : image.format;
+  texture.bind();
+  glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0
+                         , image.data.size(), &image.data[0]);
+  assert(glGetError() == GL_NO_ERROR);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  assert(glGetError() == GL_NO_ERROR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  assert(glGetError() == GL_NO_ERROR);
+}
+
+void update_texture(opengl::texture& texture, int x, int y
+                    , std::size_t width, std::size_t height, unsigned char const* rgba
+                    , pixel_format format)
+{
+  scoped_stat_timer timer(upload_time_stat);
+  if(!uploads.initialized)
+    uploads.initialize();
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  texture.bind();
+  if(uploads.has_pbo)
+  {
+    uploads.stream(rgba, width * height * 4);
+    // With a buffer bound the pointer is an offset into it
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, gl_format(format), GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(pixel_unpack_buffer, 0);
+  }
+  else
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, gl_format(format), GL_UNSIGNED_BYTE, rgba);
+  assert(glGetError() == GL_NO_ERROR);
+}
+
+texture_uploader::texture_uploader()
+  : texture_id(0), width(0), height(0), format(rgba_pixels)
+{
+}
+
+void texture_uploader::upload(opengl::texture& texture, unsigned char const* rgba
+                              , std::size_t width, std::size_t height
+                              , pixel_format format)
+{
+  if(texture.raw() == texture_id && width == this->width && height == this->height
+     && format == this->format)
+  {
+    update_texture(texture, 0, 0, width, height, rgba, format);
+    return;
+  }
+
+  upload_texture(texture, rgba, width, height, format);
+  texture_id = texture.raw();
+  this->width = width;
+  this->height = height;
+  this->format = format;
+}
+
+} } }
@@ -0,0 +1,196 @@
+/* (c) Copyright 2011-2014 Felipe Magno de Almeida
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Writes, next to every PNG and JPEG of an NCL application, the KTX
+// sidecar the player loads instead of decoding the image when the GL
+// context samples its format: ETC1 for opaque images, ETC2 RGBA8 with
+// EAC alpha for the others. Sidecars newer than their image are kept.
+
+#include <ghtv/opengl/linux/ktx.hpp>
+#include <ghtv/opengl/linux/etc_encoder.hpp>
+#include <ghtv/opengl/linux/image_conversion.hpp>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/program_options.hpp>
+
+#include <png.h>
+#include <jpeglib.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <stdexcept>
+#include <cstdio>
+
+namespace linux_ = ghtv::opengl::linux_;
+
+namespace {
+
+void read_file(std::string const& path, std::vector<unsigned char>& bytes)
+{
+  std::ifstream is(path.c_str(), std::ios::binary);
+  if(!is)
+    throw std::runtime_error("Could not open " + path);
+  bytes.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+void decode_png(std::vector<unsigned char> const& bytes, std::vector<unsigned char>& rgba
+                , std::size_t& width, std::size_t& height)
+{
+  png_image image = {};
+  image.version = PNG_IMAGE_VERSION;
+  if(!png_image_begin_read_from_memory(&image, &bytes[0], bytes.size()))
+    throw std::runtime_error(image.message);
+  image.format = PNG_FORMAT_RGBA;
+  width = image.width;
+  height = image.height;
+  rgba.resize(PNG_IMAGE_SIZE(image));
+  if(!png_image_finish_read(&image, 0, &rgba[0], 0, 0))
+    throw std::runtime_error(image.message);
+}
+
+void decode_jpg(std::vector<unsigned char>& bytes, std::vector<unsigned char>& rgba
+                , std::size_t& width, std::size_t& height)
+{
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, &bytes[0], bytes.size());
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&cinfo);
+
+  width = cinfo.output_width;
+  height = cinfo.output_height;
+  rgba.resize(4 * width * height);
+  std::vector<unsigned char> row(3 * width);
+  while(cinfo.output_scanline < cinfo.output_height)
+  {
+    unsigned char* out = &rgba[4 * width * cinfo.output_scanline];
+    JSAMPROW rows[1] = {&row[0]};
+    jpeg_read_scanlines(&cinfo, rows, 1);
+    for(std::size_t x = 0; x != width; ++x, out += 4)
+    {
+      out[0] = row[3*x];
+      out[1] = row[3*x + 1];
+      out[2] = row[3*x + 2];
+      out[3] = 0xFF;
+    }
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+}
+
+bool is_jpg(std::string const& path)
+{
+  return boost::algorithm::iends_with(path, ".jpg")
+    || boost::algorithm::iends_with(path, ".jpeg");
+}
+
+// Written aside and renamed, so a running player never reads half a file
+void transcode(std::string const& path, std::string const& sidecar
+               , std::size_t& rgba_bytes, std::size_t& ktx_bytes)
+{
+  std::vector<unsigned char> bytes, rgba;
+  std::size_t width = 0, height = 0;
+  read_file(path, bytes);
+  if(is_jpg(path))
+    decode_jpg(bytes, rgba, width, height);
+  else
+    decode_png(bytes, rgba, width, height);
+  if(!width || !height)
+    throw std::runtime_error("Empty image");
+
+  linux_::compressed_image image;
+  if(linux_::rgba_opaque(&rgba[0], width * height))
+    linux_::compress_etc1(&rgba[0], width, height, image);
+  else
+    linux_::compress_etc2_eac(&rgba[0], width, height, image);
+
+  std::string const temporary = sidecar + ".tmp";
+  linux_::write_ktx(temporary, image);
+  boost::filesystem::rename(temporary, sidecar);
+
+  rgba_bytes += rgba.size();
+  ktx_bytes += image.data.size();
+  std::cout << path << ": " << width << 'x' << height << ' '
+            << (image.opaque() ? "ETC1" : "ETC2 RGBA8 EAC") << ", "
+            << image.data.size() / 1024 << " KiB instead of " << rgba.size() / 1024
+            << " KiB" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  std::string directory;
+  bool force = false;
+  boost::program_options::options_description description("Allowed options");
+  description.add_options()
+    ("help", "produce help message")
+    ("force", "transcode images whose sidecar is up to date")
+    ("directory", boost::program_options::value<std::string>(&directory)
+     , "directory of the NCL application")
+    ;
+  boost::program_options::positional_options_description positional;
+  positional.add("directory", 1);
+
+  boost::program_options::variables_map vm;
+  boost::program_options::store(boost::program_options::command_line_parser(argc, argv)
+                                .options(description).positional(positional).run(), vm);
+  boost::program_options::notify(vm);
+  if(vm.count("help") || directory.empty())
+  {
+    std::cout << "Usage: ktx-transcode [--force] <directory>\n" << description << std::endl;
+    return 1;
+  }
+  force = vm.count("force") != 0;
+
+  std::size_t transcoded = 0, failed = 0, rgba_bytes = 0, ktx_bytes = 0;
+  for(boost::filesystem::recursive_directory_iterator first(directory), last
+        ; first != last; ++first)
+  {
+    std::string const path = first->path().string();
+    if(!boost::filesystem::is_regular_file(first->status())
+       || !(is_jpg(path) || boost::algorithm::iends_with(path, ".png")))
+      continue;
+
+    std::string const sidecar = linux_::ktx_sidecar_path(path);
+    if(!force && boost::filesystem::exists(sidecar)
+       && boost::filesystem::last_write_time(sidecar) >= boost::filesystem::last_write_time(path))
+      continue;
+
+    try
+    {
+      transcode(path, sidecar, rgba_bytes, ktx_bytes);
+      ++transcoded;
+    }
+    catch(std::exception const& e)
+    {
+      std::cout << "Could not transcode " << path << ": " << e.what() << std::endl;
+      ++failed;
+    }
+  }
+
+  std::cout << transcoded << " images transcoded, " << failed << " failed, "
+            << ktx_bytes / 1024 << " KiB of textures instead of " << rgba_bytes / 1024
+            << " KiB" << std::endl;
+  return failed ? 1 : 0;
+}